@@ -0,0 +1,134 @@
+#pragma once
+
+#include <Pies/Solver.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using namespace Pies;
+
+namespace PiesForAlthea {
+struct AdaptiveStepOptions {
+  // Enables substepping, when disabled every step that isn't skipped by
+  // sleeping is a single solver tick of the full timestep. Off by default
+  // since substepping only ever adds solver ticks.
+  bool enabled = false;
+
+  // Largest deviation of any node from its ballistic path over a substep,
+  // measured in node radii, below which the scene is considered converged
+  float tolerance = 0.1f;
+  // Should match the solver's gravity, so that falling nodes aren't taken
+  // for colliding ones
+  glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+
+  uint32_t minSubsteps = 1;
+  uint32_t maxSubsteps = 8;
+
+  // Wall-clock budget for a whole step, once exceeded the remaining
+  // simulation time is taken as a single substep
+  float timeBudgetMs = 8.0f;
+
+  // Once no node has moved faster than sleepSpeed for sleepSteps steps in a
+  // row the scene is put to sleep, and only every sleepInterval-th step
+  // ticks the solver to check whether anything started moving again. The
+  // other steps cost nothing. Independent of enabled, a sleepSpeed of 0
+  // keeps the scene awake.
+  float sleepSpeed = 0.05f;
+  uint32_t sleepSteps = 20;
+  uint32_t sleepInterval = 8;
+};
+
+struct AdaptiveStepStats {
+  uint32_t substeps = 0;
+  float residual = 0.0f;
+  float elapsedMs = 0.0f;
+  bool converged = false;
+  bool budgetExceeded = false;
+  // The step was skipped without ticking the solver
+  bool asleep = false;
+};
+
+// Scales the solver work of each simulation step with how much is going on.
+// Scenes that have come to rest are put to sleep and only tick the solver
+// on every few steps. When enabled, steps are also split into substeps for
+// accuracy, the count of which is driven by how far nodes deviate from
+// ballistic motion. Scenes with active collisions are refined up to the
+// configured maximum or until the time budget runs out. The solver's own
+// iteration count isn't exposed by Pies, so an awake step costs at least
+// one solver tick.
+class AdaptiveStepper {
+public:
+  AdaptiveStepper() = default;
+  AdaptiveStepper(const AdaptiveStepOptions& options);
+
+  const AdaptiveStepStats& step(Solver& solver, float timeStep);
+  // Same as above with the solver reduced to its tick and its vertices,
+  // which tick has to update in place
+  const AdaptiveStepStats& step(
+      const std::function<void(float)>& tick,
+      const std::vector<Solver::Vertex>& vertices,
+      float timeStep);
+
+  // Forget the motion history, should be called when the solver is cleared
+  void reset();
+
+  // Raise the substep count for the next step, e.g. when an upcoming impact
+  // has been detected outside of the stepper. Only a hint, the count stays
+  // within the configured range and the step may still finish early once
+  // converged or over budget.
+  void requestSubsteps(uint32_t substeps);
+
+  // Split the next step into at least this many equal substeps, even when
+  // disabled. Unlike requestSubsteps this ignores convergence and the time
+  // budget, it is meant for keeping fast nodes from tunneling. The count is
+  // still capped at maxSubsteps, so a governed maximum bounds the cost of
+  // fast scenes as well. It also wakes a sleeping scene.
+  void requireSubsteps(uint32_t substeps);
+
+  void setOptions(const AdaptiveStepOptions& options);
+  const AdaptiveStepOptions& getOptions() const { return this->_options; }
+
+  const AdaptiveStepStats& getStats() const { return this->_stats; }
+  uint32_t getTargetSubsteps() const { return this->_substeps; }
+
+  // Largest deviation of any node from its ballistic path since the last
+  // call, in node radii. Returns a negative residual if there is no motion
+  // history to compare against (e.g. right after bodies were spawned).
+  float measureResidual(
+      const std::vector<Solver::Vertex>& vertices,
+      float deltaTime);
+
+  // Whether the next step is skipped, unless it is due to check for motion
+  // or the node count changes
+  bool isAsleep() const;
+
+private:
+  void _validateOptions();
+  void _substep(
+      const std::function<void(float)>& tick,
+      const std::vector<Solver::Vertex>& vertices,
+      float timeStep,
+      uint32_t requiredSubsteps);
+  // Counts the steps in a row without any fast node
+  void _updateSleep(
+      const std::vector<Solver::Vertex>& vertices,
+      float timeStep);
+
+  AdaptiveStepOptions _options{};
+  AdaptiveStepStats _stats{};
+
+  uint32_t _substeps = 1;
+  // Hard minimum for the next step only
+  uint32_t _requiredSubsteps = 1;
+
+  std::vector<glm::vec3> _prevPositions;
+  std::vector<glm::vec3> _prevVelocities;
+
+  // Positions at the end of the last step that ticked the solver
+  std::vector<glm::vec3> _sleepPositions;
+  uint32_t _calmSteps = 0;
+  uint32_t _skippedSteps = 0;
+};
+} // namespace PiesForAlthea
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace PiesForAlthea {
+// Helpers for the raw binary caches, which are only ever read back by the
+// same build on the same machine so no attempt is made at portability
+
+template <typename T> void writeValue(std::ostream& stream, const T& value) {
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T> bool readValue(std::istream& stream, T& value) {
+  return static_cast<bool>(
+      stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template <typename T>
+void writeVector(std::ostream& stream, const std::vector<T>& values) {
+  writeValue(stream, static_cast<uint64_t>(values.size()));
+  stream.write(
+      reinterpret_cast<const char*>(values.data()),
+      values.size() * sizeof(T));
+}
+
+// Fails on counts above maxCount rather than trying to allocate them
+template <typename T>
+bool readVector(
+    std::istream& stream,
+    std::vector<T>& values,
+    uint64_t maxCount = uint64_t(1) << 32) {
+  uint64_t count = 0;
+  if (!readValue(stream, count) || count > maxCount) {
+    return false;
+  }
+
+  values.resize(count);
+  return static_cast<bool>(stream.read(
+      reinterpret_cast<char*>(values.data()),
+      count * sizeof(T)));
+}
+
+inline void writeString(std::ostream& stream, const std::string& value) {
+  writeValue(stream, static_cast<uint64_t>(value.size()));
+  stream.write(value.data(), value.size());
+}
+
+inline bool readString(
+    std::istream& stream,
+    std::string& value,
+    uint64_t maxSize = 1 << 16) {
+  uint64_t size = 0;
+  if (!readValue(stream, size) || size > maxSize) {
+    return false;
+  }
+
+  value.resize(size);
+  return static_cast<bool>(stream.read(value.data(), size));
+}
+} // namespace PiesForAlthea
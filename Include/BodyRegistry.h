@@ -0,0 +1,140 @@
+#pragma once
+
+#include <Pies/Solver.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+using namespace Pies;
+
+namespace PiesForAlthea {
+enum class BodyType : uint32_t { TET_BOX, SHEET, BEND_SHEET, COUNT };
+
+struct SpawnParams {
+  BodyType type = BodyType::TET_BOX;
+  float scale = 1.0f;
+  float stiffness = 1.0f;
+  float mass = 1.0f;
+  bool pinned = false;
+};
+
+// The spawn params that determine how many nodes and constraints a body
+// gets. Stiffness, mass and pinning only change their values.
+struct BodyTopologyKey {
+  BodyType type = BodyType::TET_BOX;
+  float scale = 1.0f;
+
+  BodyTopologyKey() = default;
+  explicit BodyTopologyKey(const SpawnParams& params);
+
+  bool operator==(const BodyTopologyKey& other) const;
+};
+
+struct BodyTopologyKeyHash {
+  size_t operator()(const BodyTopologyKey& key) const;
+};
+
+struct SpawnRequest {
+  SpawnParams params{};
+  glm::vec3 translation = glm::vec3(0.0f);
+  // Only used by tet boxes
+  glm::vec3 initialVelocity = glm::vec3(0.0f);
+};
+
+// How much a body appended to the solver's node, line and triangle lists.
+// Bodies with the same topology key share one entry, the index lists
+// themselves are only kept by the solver.
+struct BodyTopologySizes {
+  BodyTopologyKey key{};
+  uint32_t nodeCount = 0;
+  uint32_t lineIndexCount = 0;
+  uint32_t triangleIndexCount = 0;
+};
+
+struct BodyInstance {
+  uint32_t sizesId;
+  uint32_t firstNode;
+};
+
+// Spawns bodies into a solver and keeps track of which nodes belong to which
+// body. Sizes are captured once per topology key and shared between all
+// instances, each body only stores its sizes id and node offset. A body
+// that doesn't match the cached sizes gets an entry of its own, so the
+// registry always agrees with what the solver appended.
+class BodyRegistry {
+public:
+  uint32_t spawn(Solver& solver, const SpawnRequest& request);
+  uint32_t spawnTetBox(
+      Solver& solver,
+      const glm::vec3& translation,
+      float scale,
+      const glm::vec3& initialVelocity,
+      float stiffness,
+      float mass,
+      bool pinned);
+  uint32_t spawnSheet(
+      Solver& solver,
+      const glm::vec3& translation,
+      float scale,
+      float mass,
+      float stiffness);
+  uint32_t spawnBendSheet(
+      Solver& solver,
+      const glm::vec3& translation,
+      float scale,
+      float stiffness);
+
+  // Forget all spawned bodies, the cached sizes are kept around
+  void clear();
+
+  const std::vector<BodyInstance>& getBodies() const { return this->_bodies; }
+  const BodyTopologySizes& getSizes(uint32_t sizesId) const {
+    return this->_sizes[sizesId];
+  }
+  size_t getSizesCount() const { return this->_sizes.size(); }
+
+  // Returns nullptr if no body with this topology has been spawned yet
+  const BodyTopologySizes* findSizes(const SpawnParams& params) const;
+
+  // CPU memory held by the sizes cache and the per-body records
+  size_t getSizesBytes() const;
+  size_t getBodyBytes() const;
+
+  // Body id of each node
+  const std::vector<uint32_t>& getNodeBodies() const {
+    return this->_nodeBodies;
+  }
+
+  // Bumped by every spawn and clear, so caches of the topology can tell a
+  // scene that was cleared and respawned apart from an unchanged one
+  uint64_t getTopologyVersion() const { return this->_topologyVersion; }
+
+  uint32_t getNodeCount() const { return this->_nodeCount; }
+  size_t getLineIndexCount() const { return this->_lineIndexCount; }
+  size_t getTriangleIndexCount() const { return this->_triangleIndexCount; }
+
+private:
+  template <typename TSpawnFn>
+  uint32_t
+  _spawn(Solver& solver, const SpawnParams& params, TSpawnFn&& spawnFn);
+
+  BodyTopologySizes _measureSpawn(
+      const Solver& solver,
+      const BodyTopologyKey& key,
+      uint32_t firstNode) const;
+
+  std::vector<BodyTopologySizes> _sizes;
+  std::unordered_map<BodyTopologyKey, uint32_t, BodyTopologyKeyHash>
+      _sizesLookup;
+
+  std::vector<BodyInstance> _bodies;
+  std::vector<uint32_t> _nodeBodies;
+  uint32_t _nodeCount = 0;
+  size_t _lineIndexCount = 0;
+  size_t _triangleIndexCount = 0;
+  uint64_t _topologyVersion = 0;
+};
+} // namespace PiesForAlthea
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace PiesForAlthea {
+struct Aabb {
+  glm::vec3 min = glm::vec3(FLT_MAX);
+  glm::vec3 max = glm::vec3(-FLT_MAX);
+
+  void expand(const glm::vec3& point) {
+    this->min = glm::min(this->min, point);
+    this->max = glm::max(this->max, point);
+  }
+
+  void expand(const Aabb& other) {
+    this->min = glm::min(this->min, other.min);
+    this->max = glm::max(this->max, other.max);
+  }
+
+  void inflate(float amount) {
+    this->min -= glm::vec3(amount);
+    this->max += glm::vec3(amount);
+  }
+
+  bool overlaps(const Aabb& other) const {
+    return this->min.x <= other.max.x && other.min.x <= this->max.x &&
+           this->min.y <= other.max.y && other.min.y <= this->max.y &&
+           this->min.z <= other.max.z && other.min.z <= this->max.z;
+  }
+
+  bool contains(const glm::vec3& point) const {
+    return this->min.x <= point.x && point.x <= this->max.x &&
+           this->min.y <= point.y && point.y <= this->max.y &&
+           this->min.z <= point.z && point.z <= this->max.z;
+  }
+
+  // Slab test, returns false if the ray misses the box or only enters it
+  // beyond maxDistance
+  bool intersectRay(
+      const glm::vec3& origin,
+      const glm::vec3& invDirection,
+      float maxDistance,
+      float& entryDistance) const {
+    glm::vec3 t0 = (this->min - origin) * invDirection;
+    glm::vec3 t1 = (this->max - origin) * invDirection;
+    glm::vec3 tMin = glm::min(t0, t1);
+    glm::vec3 tMax = glm::max(t0, t1);
+    float entry = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+    float exit =
+        std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+    entryDistance = entry;
+    return entry <= exit;
+  }
+
+  glm::vec3 getCenter() const { return 0.5f * (this->min + this->max); }
+
+  float getSurfaceArea() const {
+    glm::vec3 extent = glm::max(this->max - this->min, glm::vec3(0.0f));
+    return 2.0f *
+           (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+  }
+};
+
+// Bounding volume hierarchy over a fixed set of primitive bounds. The tree
+// is built once with binned SAH splits and afterwards only refitted as the
+// primitives move, which keeps the topology but lets the boxes grow loose.
+// Callers can compare the current SAH cost against the cost right after the
+// build to decide when a full rebuild is worth it.
+class Bvh {
+public:
+  static constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+  void build(const std::vector<Aabb>& primitiveBounds);
+
+  // Primitive count and order must match the last build
+  void refit(const std::vector<Aabb>& primitiveBounds);
+
+  void clear();
+
+  // Raw binary dump of the built tree, for caching trees over static
+  // geometry. read returns false and leaves the tree empty if the stream
+  // does not hold a valid tree.
+  void write(std::ostream& stream) const;
+  bool read(std::istream& stream);
+
+  // Current SAH cost divided by the cost right after the last build, grows
+  // above 1 as refitting degrades the tree
+  float getQualityRatio() const {
+    return this->_builtCost > 0.0f ? this->_cost / this->_builtCost : 1.0f;
+  }
+
+  // Invokes fn(primitiveIndex) for every primitive whose bounds overlap the
+  // given box
+  template <typename TFn> void query(const Aabb& bounds, TFn&& fn) const {
+    if (this->_nodes.empty()) {
+      return;
+    }
+
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+      const Node& node = this->_nodes[stack[--stackSize]];
+      if (!node.bounds.overlaps(bounds)) {
+        continue;
+      }
+
+      if (node.primitiveCount > 0) {
+        for (uint32_t i = 0; i < node.primitiveCount; ++i) {
+          uint32_t primitive = this->_primitives[node.first + i];
+          if (this->_primitiveBounds[primitive].overlaps(bounds)) {
+            fn(primitive);
+          }
+        }
+      } else {
+        stack[stackSize++] = node.first;
+        stack[stackSize++] = node.first + 1;
+      }
+    }
+  }
+
+  // Walks the tree front to back along the ray, invoking
+  // fn(primitiveIndex, maxDistance) for each primitive whose box the ray
+  // enters. fn returns the distance of its hit (anything >= maxDistance for
+  // a miss), closer hits prune the rest of the traversal. Returns the
+  // closest hit distance, or maxDistance if nothing was hit.
+  template <typename TFn>
+  float raycast(
+      const glm::vec3& origin,
+      const glm::vec3& direction,
+      float maxDistance,
+      TFn&& fn) const {
+    if (this->_nodes.empty()) {
+      return maxDistance;
+    }
+
+    // Zero components would turn into 0 * inf = NaN in the slab test for
+    // rays starting exactly on a box face
+    glm::vec3 invDirection;
+    for (int i = 0; i < 3; ++i) {
+      float component = direction[i];
+      if (std::abs(component) < 1e-20f) {
+        component = std::copysign(1e-20f, component);
+      }
+      invDirection[i] = 1.0f / component;
+    }
+
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    float entry;
+    if (this->_nodes[0].bounds.intersectRay(
+            origin,
+            invDirection,
+            maxDistance,
+            entry)) {
+      stack[stackSize++] = 0;
+    }
+
+    while (stackSize > 0) {
+      const Node& node = this->_nodes[stack[--stackSize]];
+      if (!node.bounds.intersectRay(origin, invDirection, maxDistance, entry)) {
+        continue;
+      }
+
+      if (node.primitiveCount > 0) {
+        for (uint32_t i = 0; i < node.primitiveCount; ++i) {
+          uint32_t primitive = this->_primitives[node.first + i];
+          if (!this->_primitiveBounds[primitive].intersectRay(
+                  origin,
+                  invDirection,
+                  maxDistance,
+                  entry)) {
+            continue;
+          }
+
+          maxDistance = std::min(maxDistance, fn(primitive, maxDistance));
+        }
+
+        continue;
+      }
+
+      // Push the far child first so the near one is visited first
+      float leftEntry;
+      float rightEntry;
+      bool hitLeft = this->_nodes[node.first].bounds.intersectRay(
+          origin,
+          invDirection,
+          maxDistance,
+          leftEntry);
+      bool hitRight = this->_nodes[node.first + 1].bounds.intersectRay(
+          origin,
+          invDirection,
+          maxDistance,
+          rightEntry);
+      if (hitLeft && hitRight) {
+        bool leftFirst = leftEntry <= rightEntry;
+        stack[stackSize++] = leftFirst ? node.first + 1 : node.first;
+        stack[stackSize++] = leftFirst ? node.first : node.first + 1;
+      } else if (hitLeft) {
+        stack[stackSize++] = node.first;
+      } else if (hitRight) {
+        stack[stackSize++] = node.first + 1;
+      }
+    }
+
+    return maxDistance;
+  }
+
+  size_t getPrimitiveCount() const { return this->_primitiveBounds.size(); }
+  size_t getNodeCount() const { return this->_nodes.size(); }
+  size_t getDepth() const { return this->_levels.size(); }
+  size_t getBytes() const;
+
+private:
+  struct Node {
+    Aabb bounds;
+    // Index of the left child for internal nodes (the right child follows
+    // it), first entry in _primitives for leaves
+    uint32_t first = 0;
+    // Zero for internal nodes
+    uint32_t primitiveCount = 0;
+  };
+
+  float _computeCost() const;
+  // Returns false if the tree is too deep to traverse
+  bool _buildLevels();
+
+  std::vector<Node> _nodes;
+  std::vector<uint32_t> _primitives;
+  std::vector<Aabb> _primitiveBounds;
+
+  // Node indices grouped by depth, refitting walks these bottom-up so that
+  // each level can be processed in parallel
+  std::vector<std::vector<uint32_t>> _levels;
+
+  float _cost = 0.0f;
+  float _builtCost = 0.0f;
+};
+} // namespace PiesForAlthea
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "AdaptiveStepper.h"
+
+#include <Pies/Solver.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+using namespace Pies;
+
+namespace PiesForAlthea {
+struct ContinuousCollisionOptions {
+  bool enabled = true;
+
+  // Nodes that would move further than this many radii over a step are
+  // swept against the floor and other bodies
+  float fastNodeThreshold = 0.5f;
+
+  // Maximum number of times a single step gets split at an impact
+  uint32_t maxImpactSplits = 4;
+
+  float floorHeight = 0.0f;
+};
+
+// Swept-sphere collision detection for fast moving nodes. The solver only
+// resolves collisions discretely, so instead of correcting positions here
+// the simulation step is split at the earliest time of impact and the
+// remainder is stepped finely enough for the fast nodes not to tunnel. The
+// substeps are required from the stepper, so they are taken even when
+// adaptive stepping is off, up to the stepper's maxSubsteps.
+class ContinuousCollision {
+public:
+  ContinuousCollision() = default;
+  ContinuousCollision(const ContinuousCollisionOptions& options);
+
+  // Seed the motion history of freshly spawned nodes with their initial
+  // velocity, otherwise they would be treated as resting for their first
+  // step
+  void seedNodes(
+      const std::vector<Solver::Vertex>& vertices,
+      uint32_t firstNode,
+      uint32_t nodeCount,
+      const glm::vec3& velocity);
+
+  // Advance the solver by a full step through the stepper, splitting it at
+  // impacts of fast nodes
+  void step(
+      Solver& solver,
+      AdaptiveStepper& stepper,
+      const std::vector<uint32_t>& nodeBodies,
+      float timeStep);
+  // Same as above with the solver reduced to its tick and its vertices,
+  // which tick has to update in place
+  void step(
+      const std::function<void(float)>& tick,
+      const std::vector<Solver::Vertex>& vertices,
+      AdaptiveStepper& stepper,
+      const std::vector<uint32_t>& nodeBodies,
+      float timeStep);
+
+  // Record end-of-step positions, used to estimate node velocities
+  void recordStep(const std::vector<Solver::Vertex>& vertices, float deltaTime);
+
+  void reset();
+
+  // Keeps the motion history
+  void setOptions(const ContinuousCollisionOptions& options) {
+    this->_options = options;
+  }
+
+  // Returns the fraction of the upcoming step at which the first fast node
+  // touches the floor or a node of another body, or 1 if
+  // there is no impact
+  float findEarliestImpact(
+      const std::vector<Solver::Vertex>& vertices,
+      const std::vector<uint32_t>& nodeBodies,
+      float deltaTime);
+
+  // Substeps needed for the fastest node to move at most one radius per
+  // substep, as of the last call to findEarliestImpact. Not capped here,
+  // the stepper limits it to its own maxSubsteps.
+  uint32_t getRequiredSubsteps() const { return this->_requiredSubsteps; }
+
+  // Velocity of each node over the last recorded step
+  const std::vector<glm::vec3>& getVelocities() const {
+    return this->_velocities;
+  }
+
+  uint32_t getFastNodeCount() const {
+    return static_cast<uint32_t>(this->_fastNodes.size());
+  }
+
+  const ContinuousCollisionOptions& getOptions() const {
+    return this->_options;
+  }
+
+private:
+  struct CellRange {
+    int32_t minX, minY, minZ;
+    int32_t maxX, maxY, maxZ;
+  };
+
+  CellRange _getCellRange(const glm::vec3& min, const glm::vec3& max) const;
+
+  // Buckets the swept bounds of the fast nodes, inflated by reach
+  void _buildGrid(
+      const std::vector<Solver::Vertex>& vertices,
+      float deltaTime,
+      float reach);
+
+  // Earliest impact of a node against the fast nodes of other bodies in
+  // the given cells
+  float _sweepAgainstFastNodes(
+      const std::vector<Solver::Vertex>& vertices,
+      const std::vector<uint32_t>& nodeBodies,
+      uint32_t node,
+      const CellRange& cells,
+      float deltaTime) const;
+
+  ContinuousCollisionOptions _options{};
+
+  std::vector<glm::vec3> _prevPositions;
+  std::vector<glm::vec3> _velocities;
+
+  std::vector<uint32_t> _fastNodes;
+  // Cells covered by the swept bounds of each fast node
+  std::vector<CellRange> _fastNodeCells;
+  // Per node, whether it is in _fastNodes
+  std::vector<uint8_t> _isFast;
+  uint32_t _requiredSubsteps = 1;
+
+  // Uniform grid over the swept bounds of the fast nodes, inflated far
+  // enough that any node that can touch a fast node this step lies within
+  // them. Buckets are kept between steps and only emptied, so a steady
+  // stream of fast nodes doesn't allocate.
+  float _cellSize = 1.0f;
+  glm::vec3 _sweptMin = glm::vec3(0.0f);
+  glm::vec3 _sweptMax = glm::vec3(0.0f);
+  std::unordered_map<uint64_t, std::vector<uint32_t>> _grid;
+  std::vector<std::vector<uint32_t>*> _usedBuckets;
+};
+} // namespace PiesForAlthea
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "BodyRegistry.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace PiesForAlthea {
+enum class DrawListType { LINES, TRIANGLES, NODES };
+
+// Where a body's geometry lives within the scene-wide index and vertex
+// buffers
+struct BodyDrawRange {
+  uint32_t firstLineIndex;
+  uint32_t lineIndexCount;
+  uint32_t firstTriangleIndex;
+  uint32_t triangleIndexCount;
+  uint32_t firstNode;
+  uint32_t nodeCount;
+};
+
+// Builds packed indirect draw commands from per-body ranges and visibility.
+// Runs of visible bodies whose ranges follow each other are merged into a
+// single command, so a fully visible scene laid out the way the solver
+// appends bodies results in one command per list regardless of body count.
+// Ranges that aren't back to back are still drawn, just as separate
+// commands.
+class DrawListBuilder {
+public:
+  void setBodies(const BodyRegistry& bodies);
+  void setBodies(std::vector<BodyDrawRange>&& ranges);
+  // Forget all bodies along with their visibility, for when the scene is
+  // cleared
+  void clear();
+
+  void setVisible(uint32_t bodyId, bool visible);
+  void setAllVisible(bool visible);
+  bool isVisible(uint32_t bodyId) const {
+    return this->_visibility[bodyId] != 0;
+  }
+
+  // The sphere index count is only needed for node lists, where every node
+  // is drawn as an instance of the sphere mesh
+  const std::vector<VkDrawIndexedIndirectCommand>&
+  build(DrawListType type, uint32_t sphereIndexCount = 0);
+
+  uint32_t getBodyCount() const {
+    return static_cast<uint32_t>(this->_ranges.size());
+  }
+
+private:
+  std::vector<BodyDrawRange> _ranges;
+  std::vector<uint8_t> _visibility;
+  std::vector<VkDrawIndexedIndirectCommand> _commands;
+};
+} // namespace PiesForAlthea
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PiesForAlthea {
+// A grid of scene variants, every combination of the listed values is run
+// as an independent simulation
+struct EnsembleOptions {
+  std::vector<float> stiffnesses = {1000.0f};
+  std::vector<float> gridSpacings = {1.0f};
+  std::vector<float> launchSpeeds = {15.0f};
+
+  uint32_t stepCount = 200;
+  float timeStep = 0.05f;
+  float floorHeight = -8.0f;
+
+  // Only used to report potential energy, should match the solver
+  float gravity = 9.81f;
+
+  // Zero means one worker per hardware thread
+  uint32_t workerCount = 0;
+
+  std::string outputPath = "ensemble_results.csv";
+};
+
+struct EnsembleRunResult {
+  float stiffness;
+  float gridSpacing;
+  float launchSpeed;
+
+  uint32_t nodeCount = 0;
+  double totalStepMs = 0.0;
+  double maxStepMs = 0.0;
+
+  // Energies are per unit node mass, Pies doesn't expose the masses of
+  // its nodes. Every variant spawns its bodies with the same mass, so runs
+  // remain comparable with each other.
+  double kineticEnergy = 0.0;
+  double potentialEnergy = 0.0;
+
+  // Deepest any node sank below the floor over the whole run
+  float maxPenetration = 0.0f;
+
+  // Empty unless the run failed, in which case the metrics above are
+  // incomplete
+  std::string error;
+};
+
+// Runs every variant of the base scene headlessly, one solver per worker
+// thread, and writes one line of metrics per run to a CSV file. A run that
+// throws doesn't take the others down, its error is recorded in its result
+// instead.
+class EnsembleRunner {
+public:
+  EnsembleRunner(const EnsembleOptions& options);
+
+  const std::vector<EnsembleRunResult>& run();
+  void writeResults() const;
+
+  // Number of runs of the last call to run() that recorded an error
+  uint32_t getFailedRunCount() const;
+
+  // Parses "--stiffness 100,1000 --grid-spacing 0.5,1 --launch-speed 15
+  // --steps 200 --workers 8 --out results.csv", throws on malformed args
+  static EnsembleOptions parseArgs(int argc, char** argv, int firstArg);
+
+private:
+  EnsembleRunResult _runVariant(
+      float stiffness,
+      float gridSpacing,
+      float launchSpeed) const;
+
+  EnsembleOptions _options;
+  std::vector<EnsembleRunResult> _results;
+};
+} // namespace PiesForAlthea
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace PiesForAlthea {
+// Layout of the shared memory segment the simulation publishes its node
+// positions into. It is shared between the exporter and the reader library,
+// so it only depends on the standard library.
+//
+// The segment is a header followed by a ring of slots. Every slot is guarded
+// by its own sequence counter, which is odd while the writer is filling the
+// slot. Readers sample the counter before and after reading a slot and only
+// trust the frame if it was even and unchanged, so the writer never waits
+// on them. With several slots a reader has a few frames of headroom before
+// the slot it is reading gets overwritten.
+
+constexpr uint32_t FRAME_EXPORT_MAGIC = 0x58454650; // "PFEX"
+constexpr uint32_t FRAME_EXPORT_VERSION = 1;
+
+// Both sides of the protocol live in different processes, so the counters
+// have to work without a lock
+static_assert(
+    std::atomic<uint64_t>::is_always_lock_free,
+    "Frame export needs lock-free 64-bit atomics");
+static_assert(
+    std::atomic<uint32_t>::is_always_lock_free,
+    "Frame export needs lock-free 32-bit atomics");
+
+struct FrameExportNode {
+  float position[3];
+  float radius;
+};
+
+struct alignas(64) FrameExportHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slotCount;
+  // Max nodes per slot, the writer moves to a bigger segment when exceeded
+  uint32_t nodeCapacity;
+  uint64_t slotStride;
+  // Number of frames published so far, the newest one is in slot
+  // (publishedFrames - 1) % slotCount
+  std::atomic<uint64_t> publishedFrames;
+  // Set once the writer has stopped writing to this segment, readers
+  // should reopen the segment by name to follow it
+  std::atomic<uint32_t> closed;
+};
+
+struct alignas(64) FrameExportSlot {
+  std::atomic<uint64_t> sequence;
+  uint64_t frameIndex;
+  // Bumped whenever bodies are added or removed, node indices are only
+  // comparable between frames with the same topology version
+  uint64_t topologyVersion;
+  uint32_t nodeCount;
+  uint32_t padding;
+};
+
+inline uint64_t getFrameExportSlotStride(uint32_t nodeCapacity) {
+  uint64_t bytes =
+      sizeof(FrameExportSlot) +
+      static_cast<uint64_t>(nodeCapacity) * sizeof(FrameExportNode);
+  return (bytes + alignof(FrameExportSlot) - 1) /
+         alignof(FrameExportSlot) * alignof(FrameExportSlot);
+}
+
+inline uint64_t
+getFrameExportSize(uint32_t slotCount, uint32_t nodeCapacity) {
+  return sizeof(FrameExportHeader) +
+         slotCount * getFrameExportSlotStride(nodeCapacity);
+}
+
+inline FrameExportSlot* getFrameExportSlot(void* pSegment, uint32_t slot) {
+  FrameExportHeader* pHeader = static_cast<FrameExportHeader*>(pSegment);
+  return reinterpret_cast<FrameExportSlot*>(
+      static_cast<char*>(pSegment) + sizeof(FrameExportHeader) +
+      slot * pHeader->slotStride);
+}
+
+inline FrameExportNode* getFrameExportNodes(FrameExportSlot* pSlot) {
+  return reinterpret_cast<FrameExportNode*>(pSlot + 1);
+}
+} // namespace PiesForAlthea
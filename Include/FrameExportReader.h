@@ -0,0 +1,71 @@
+#pragma once
+
+#include "FrameExportLayout.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PiesForAlthea {
+enum class FrameReadStatus {
+  OK,
+  // Nothing has been published yet
+  NO_FRAME,
+  // The writer kept overwriting the slots being read, try again
+  RETRY,
+  // The writer moved to a new segment or shut down, reopen to follow it
+  CLOSED
+};
+
+// Points straight into the shared segment. The contents are only known to
+// be consistent if FrameExportReader::endRead() returns true once the
+// caller is done with them.
+struct FrameView {
+  const FrameExportNode* pNodes = nullptr;
+  uint32_t nodeCount = 0;
+  uint64_t frameIndex = 0;
+  uint64_t topologyVersion = 0;
+
+  const FrameExportSlot* pSlot = nullptr;
+  uint64_t sequence = 0;
+};
+
+// Reads the frames published by a FrameExporter in another process. Reading
+// never blocks the writer, a reader that is too slow just has to retry.
+// Built as its own small library that only depends on the standard library
+// and POSIX, so external tools can link it. Not available on Windows.
+class FrameExportReader {
+public:
+  FrameExportReader() = default;
+  ~FrameExportReader();
+
+  FrameExportReader(const FrameExportReader&) = delete;
+  FrameExportReader& operator=(const FrameExportReader&) = delete;
+
+  // Fails if the segment doesn't exist yet or wasn't written by a
+  // compatible exporter
+  bool open(const std::string& name);
+  void close();
+
+  bool isOpen() const { return this->_pSegment != nullptr; }
+
+  // Zero-copy access to the newest frame
+  FrameReadStatus beginRead(FrameView& view) const;
+  // Whether the frame stayed untouched since beginRead()
+  bool endRead(const FrameView& view) const;
+
+  // Copies the newest consistent frame, reopening the segment if the
+  // writer has moved to a new one. Returns false if there is no frame to
+  // read right now.
+  bool readLatest(
+      std::vector<FrameExportNode>& nodes,
+      uint64_t& frameIndex,
+      uint64_t& topologyVersion);
+
+private:
+  std::string _name;
+  void* _pSegment = nullptr;
+  size_t _segmentSize = 0;
+};
+} // namespace PiesForAlthea
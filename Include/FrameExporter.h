@@ -0,0 +1,53 @@
+#pragma once
+
+#include "FrameExportLayout.h"
+
+#include <Pies/Solver.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace Pies;
+
+namespace PiesForAlthea {
+// Publishes the node positions of every step into a POSIX shared memory
+// segment (see FrameExportLayout.h) for other processes to read without
+// copying. Publishing never blocks on readers. Not available on Windows,
+// where open() always fails.
+class FrameExporter {
+public:
+  FrameExporter() = default;
+  ~FrameExporter();
+
+  FrameExporter(const FrameExporter&) = delete;
+  FrameExporter& operator=(const FrameExporter&) = delete;
+
+  // The name is a shared memory object name like "/pies-frames". Any
+  // existing segment with that name is replaced.
+  bool open(const std::string& name, uint32_t slotCount = 4);
+  // Marks the segment closed for readers and unlinks it
+  void close();
+
+  bool isOpen() const { return this->_pSegment != nullptr; }
+
+  // Grows the segment when there are more nodes than fit in a slot, readers
+  // see the old segment closed and have to reopen it
+  void publish(
+      const std::vector<Solver::Vertex>& vertices,
+      uint64_t topologyVersion);
+
+  uint64_t getPublishedFrames() const { return this->_frameIndex; }
+
+private:
+  bool _createSegment(uint32_t nodeCapacity);
+  void _releaseSegment();
+
+  std::string _name;
+  uint32_t _slotCount = 0;
+  uint64_t _frameIndex = 0;
+
+  void* _pSegment = nullptr;
+  size_t _segmentSize = 0;
+};
+} // namespace PiesForAlthea
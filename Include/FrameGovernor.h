@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace PiesForAlthea {
+struct FrameGovernorOptions {
+  // Off by default, full quality is kept regardless of the frame cost
+  bool enabled = false;
+
+  float targetFrameMs = 16.0f;
+
+  // Quality steps down when the smoothed frame cost stays above
+  // degradeRatio * target and back up when it stays below
+  // recoverRatio * target. The gap between the two keeps the governor from
+  // bouncing between neighbouring levels.
+  float degradeRatio = 1.0f;
+  float recoverRatio = 0.6f;
+
+  // Consecutive frames a condition has to hold before acting on it,
+  // recovering is deliberately slower than degrading
+  uint32_t degradeFrames = 3;
+  uint32_t recoverFrames = 60;
+
+  // Weight of the newest frame in the smoothed frame cost
+  float smoothing = 0.2f;
+
+  // Oldest decisions are dropped beyond this many, zero keeps all of them
+  size_t maxLogSize = 0;
+};
+
+// What each quality level allows, level 0 is full quality
+struct QualitySettings {
+  // The stepper's max substeps are divided by this. That caps the substeps
+  // forced by continuous collision at all times, adaptive substeps only
+  // exist while the stepper is enabled.
+  uint32_t substepDivisor;
+  // Upper bound on the continuous collision option of the same name, every
+  // split costs at least one extra solver tick
+  uint32_t maxImpactSplits;
+  uint32_t sphereResolution;
+};
+
+struct GovernorDecision {
+  uint64_t frame;
+  uint32_t fromLevel;
+  uint32_t toLevel;
+  float smoothedMs;
+  float solverMs;
+  float renderPrepMs;
+};
+
+// Returns the current time in milliseconds
+using GovernorClock = std::function<double()>;
+
+// Keeps the frame cost of the simulation within a budget by stepping
+// through a fixed ladder of quality levels. Solver and render-prep costs
+// are reported each frame, and the level changes only after the smoothed
+// cost has stayed out of bounds for a number of frames. The clock is
+// pluggable so the control logic can be driven without a GPU or real time.
+class FrameGovernor {
+public:
+  // Uses a steady wall clock
+  FrameGovernor();
+  FrameGovernor(const FrameGovernorOptions& options, GovernorClock clock = {});
+
+  double now() const { return this->_clock(); }
+
+  void addSolverMs(double ms) { this->_solverMs += static_cast<float>(ms); }
+  void addRenderPrepMs(double ms) {
+    this->_renderPrepMs += static_cast<float>(ms);
+  }
+
+  // Closes the current frame and starts the next, returns true if the
+  // quality level changed
+  bool endFrame();
+
+  void setOptions(const FrameGovernorOptions& options);
+  // An empty clock restores the steady wall clock
+  void setClock(GovernorClock clock);
+  const FrameGovernorOptions& getOptions() const { return this->_options; }
+
+  uint32_t getLevel() const { return this->_level; }
+  const QualitySettings& getSettings() const;
+  static uint32_t getLevelCount();
+
+  float getSmoothedMs() const { return this->_smoothedMs; }
+  uint64_t getFrameCount() const { return this->_frame; }
+
+  // Every level change, oldest first
+  const std::deque<GovernorDecision>& getLog() const { return this->_log; }
+
+private:
+  void _setLevel(uint32_t level, float solverMs, float renderPrepMs);
+  void _trimLog();
+
+  FrameGovernorOptions _options{};
+  GovernorClock _clock;
+
+  uint32_t _level = 0;
+  uint64_t _frame = 0;
+
+  float _solverMs = 0.0f;
+  float _renderPrepMs = 0.0f;
+  float _smoothedMs = 0.0f;
+  bool _hasSample = false;
+
+  uint32_t _overBudgetFrames = 0;
+  uint32_t _underBudgetFrames = 0;
+
+  std::deque<GovernorDecision> _log;
+};
+} // namespace PiesForAlthea
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Althea/Allocator.h>
+#include <Althea/Application.h>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+using namespace AltheaEngine;
+
+namespace PiesForAlthea {
+// Persistently mapped indirect draw buffer with one region of commands per
+// frame in flight, analogous to DynamicVertexBuffer. Althea doesn't expose
+// which features it enabled on the device, and what the physical device
+// supports says nothing about that. So neither multiDrawIndirect nor
+// drawIndirectFirstInstance is relied on: every command is its own indirect
+// draw, and commands starting past instance zero are drawn directly from a
+// CPU copy.
+class IndirectDrawBuffer {
+public:
+  IndirectDrawBuffer() = default;
+  IndirectDrawBuffer(
+      Application& app,
+      VkCommandBuffer commandBuffer,
+      uint32_t maxDrawCount);
+  ~IndirectDrawBuffer();
+
+  IndirectDrawBuffer(IndirectDrawBuffer&& rhs);
+  IndirectDrawBuffer& operator=(IndirectDrawBuffer&& rhs);
+
+  // Commands beyond the max draw count are dropped
+  void updateDraws(
+      uint32_t ringBufferIndex,
+      const std::vector<VkDrawIndexedIndirectCommand>& draws);
+
+  void draw(VkCommandBuffer commandBuffer, uint32_t ringBufferIndex) const;
+
+  uint32_t getDrawCount(uint32_t ringBufferIndex) const {
+    return this->_drawCounts[ringBufferIndex];
+  }
+  uint32_t getMaxDrawCount() const { return this->_maxDrawCount; }
+  size_t getSize() const {
+    return MAX_FRAMES_IN_FLIGHT * this->_maxDrawCount *
+           sizeof(VkDrawIndexedIndirectCommand);
+  }
+
+private:
+  BufferAllocation _allocation;
+  void* _pMappedMemory = nullptr;
+  uint32_t _maxDrawCount = 0;
+  uint32_t _drawCounts[MAX_FRAMES_IN_FLIGHT] = {};
+
+  // CPU copy of the commands, to find the ones needing a direct draw
+  std::vector<VkDrawIndexedIndirectCommand> _cpuDraws[MAX_FRAMES_IN_FLIGHT];
+};
+} // namespace PiesForAlthea
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "BodyRegistry.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace PiesForAlthea {
+struct MemoryReport {
+  // CPU memory
+  size_t solverVertexBytes = 0;
+  // Estimated from MemoryBudget::solverBytesPerNode, the solver's internal
+  // node and constraint storage is not visible from here
+  size_t solverInternalBytes = 0;
+  size_t stepperHistoryBytes = 0;
+  size_t topologySizesBytes = 0;
+  size_t bodyBytes = 0;
+  size_t sceneQueryBytes = 0;
+  size_t environmentBytes = 0;
+
+  // GPU memory
+  size_t vertexBufferBytes = 0;
+  // Number of copies of the dynamic vertex buffer, one per frame in flight
+  uint32_t ringBufferMultiplier = 1;
+  size_t linesIndexBufferBytes = 0;
+  size_t trianglesIndexBufferBytes = 0;
+  size_t indirectDrawBytes = 0;
+  size_t stagingBytes = 0;
+  size_t sphereBytes = 0;
+  size_t staticGeometryBytes = 0;
+
+  // CPU and GPU memory attributable to the bodies of each type
+  std::array<uint32_t, static_cast<size_t>(BodyType::COUNT)> bodyCounts{};
+  std::array<size_t, static_cast<size_t>(BodyType::COUNT)> bodyTypeBytes{};
+
+  size_t getCpuBytes() const {
+    return solverVertexBytes + solverInternalBytes + stepperHistoryBytes +
+           topologySizesBytes + bodyBytes + sceneQueryBytes +
+           environmentBytes;
+  }
+
+  size_t getGpuBytes() const {
+    return vertexBufferBytes + linesIndexBufferBytes +
+           trianglesIndexBufferBytes + indirectDrawBytes + stagingBytes +
+           sphereBytes + staticGeometryBytes;
+  }
+
+  size_t getTotalBytes() const { return getCpuBytes() + getGpuBytes(); }
+};
+
+struct MemoryBudget {
+  // Zero means unlimited
+  size_t maxBytes = 0;
+
+  // When set, spawns that would exceed the budget are queued and retried
+  // every tick, otherwise they are rejected. Spawns that wouldn't fit even
+  // into an empty scene are always rejected.
+  bool queueOverBudget = false;
+  // Spawns beyond this many queued ones are rejected
+  uint32_t maxPendingSpawns = 64;
+
+  // Charged for body topologies that have never been spawned before, since
+  // their size is only known once the solver has built them. The largest
+  // known body size is charged instead if it is bigger.
+  size_t unknownSpawnBytes = 1 << 20;
+
+  // Rough size of the solver's per-node state (node, constraints, spatial
+  // hash entries) used for capacity estimates
+  size_t solverBytesPerNode = 256;
+};
+
+enum class SpawnResult { SPAWNED, QUEUED, REJECTED };
+} // namespace PiesForAlthea
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace PiesForAlthea {
+inline size_t getWorkerCount() {
+  return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+// Persistent threads shared by every parallelFor, so the per-tick callers
+// don't pay for starting threads. The thread submitting a job works on it
+// too and only waits for chunks other threads already started, which keeps
+// nested and concurrent submissions from deadlocking.
+class WorkerPool {
+public:
+  static WorkerPool& get() {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      this->_stopping = true;
+    }
+    this->_workAvailable.notify_all();
+
+    for (std::thread& worker : this->_workers) {
+      worker.join();
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // Invokes fn(chunk) for every chunk in [0, chunkCount). If fn throws, the
+  // first exception is rethrown here once all started chunks are finished.
+  template <typename TFn> void run(size_t chunkCount, TFn& fn) {
+    Job job;
+    job.pRun = [](void* pFn, size_t chunk) {
+      (*static_cast<TFn*>(pFn))(chunk);
+    };
+    job.pFn = &fn;
+    job.chunkCount = chunkCount;
+
+    {
+      JobScope scope(*this, job);
+      size_t chunk = 0;
+      while (this->_claimChunk(job, chunk)) {
+        this->_runChunk(job, chunk);
+      }
+    }
+
+    if (job.exception) {
+      std::rethrow_exception(job.exception);
+    }
+  }
+
+private:
+  struct Job {
+    void (*pRun)(void*, size_t) = nullptr;
+    void* pFn = nullptr;
+    size_t chunkCount = 0;
+    // All guarded by the pool's mutex
+    size_t nextChunk = 0;
+    size_t finishedChunks = 0;
+    std::exception_ptr exception;
+  };
+
+  // Queues the job for the workers and takes it back off the queue however
+  // the scope is left, waiting for the chunks that were already started.
+  // Nothing refers to the job anymore once the scope is left.
+  class JobScope {
+  public:
+    JobScope(WorkerPool& pool, Job& job) : _pool(pool), _job(job) {
+      {
+        std::lock_guard<std::mutex> lock(this->_pool._mutex);
+        this->_pool._jobs.push_back(&this->_job);
+      }
+      this->_pool._workAvailable.notify_all();
+    }
+
+    ~JobScope() {
+      std::unique_lock<std::mutex> lock(this->_pool._mutex);
+      auto it = std::find(
+          this->_pool._jobs.begin(),
+          this->_pool._jobs.end(),
+          &this->_job);
+      if (it != this->_pool._jobs.end()) {
+        this->_pool._jobs.erase(it);
+      }
+
+      this->_pool._jobDone.wait(lock, [&job = this->_job]() {
+        return job.finishedChunks == job.nextChunk;
+      });
+    }
+
+    JobScope(const JobScope&) = delete;
+    JobScope& operator=(const JobScope&) = delete;
+
+  private:
+    WorkerPool& _pool;
+    Job& _job;
+  };
+
+  WorkerPool() {
+    size_t workerCount = getWorkerCount() - 1;
+    this->_workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+      this->_workers.emplace_back([this]() { this->_workerLoop(); });
+    }
+  }
+
+  bool _claimChunk(Job& job, size_t& chunk) {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    if (job.nextChunk == job.chunkCount) {
+      return false;
+    }
+
+    chunk = job.nextChunk++;
+    if (job.nextChunk == job.chunkCount) {
+      this->_jobs.erase(
+          std::find(this->_jobs.begin(), this->_jobs.end(), &job));
+    }
+
+    return true;
+  }
+
+  void _runChunk(Job& job, size_t chunk) {
+    std::exception_ptr exception;
+    try {
+      job.pRun(job.pFn, chunk);
+    } catch (...) {
+      exception = std::current_exception();
+    }
+
+    bool done = false;
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      if (exception && !job.exception) {
+        job.exception = exception;
+      }
+      // Every started chunk is finished, the job may be waiting for that
+      done = ++job.finishedChunks == job.nextChunk;
+    }
+
+    if (done) {
+      this->_jobDone.notify_all();
+    }
+  }
+
+  void _workerLoop() {
+    while (true) {
+      Job* pJob = nullptr;
+      size_t chunk = 0;
+      {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        this->_workAvailable.wait(lock, [this]() {
+          return this->_stopping || !this->_jobs.empty();
+        });
+        if (this->_stopping) {
+          return;
+        }
+
+        pJob = this->_jobs.front();
+        chunk = pJob->nextChunk++;
+        if (pJob->nextChunk == pJob->chunkCount) {
+          this->_jobs.pop_front();
+        }
+      }
+
+      this->_runChunk(*pJob, chunk);
+    }
+  }
+
+  std::vector<std::thread> _workers;
+
+  std::mutex _mutex;
+  std::condition_variable _workAvailable;
+  std::condition_variable _jobDone;
+  // Jobs that still have unclaimed chunks
+  std::deque<Job*> _jobs;
+  bool _stopping = false;
+};
+
+// Splits [0, count) into contiguous chunks of at least minChunkSize and
+// invokes fn(begin, end) for each chunk on the worker pool. Small ranges run
+// inline on the calling thread. An exception thrown by fn is rethrown to the
+// caller after the other chunks have finished.
+template <typename TFn>
+void parallelFor(size_t count, size_t minChunkSize, TFn&& fn) {
+  if (count == 0) {
+    return;
+  }
+
+  size_t chunkCount = std::min(
+      getWorkerCount(),
+      (count + minChunkSize - 1) / std::max<size_t>(minChunkSize, 1));
+  if (chunkCount <= 1) {
+    fn(size_t(0), count);
+    return;
+  }
+
+  size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+  auto runChunk = [&fn, chunkSize, count](size_t chunk) {
+    size_t begin = chunk * chunkSize;
+    size_t end = std::min(begin + chunkSize, count);
+    if (begin < end) {
+      fn(begin, end);
+    }
+  };
+
+  WorkerPool::get().run(chunkCount, runChunk);
+}
+} // namespace PiesForAlthea
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Bvh.h"
+#include "StaticEnvironment.h"
+
+#include <Pies/Solver.h>
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace Pies;
+
+namespace PiesForAlthea {
+struct Ray {
+  glm::vec3 origin = glm::vec3(0.0f);
+  // Does not need to be normalized, hit distances are in world units
+  glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+  float maxDistance = FLT_MAX;
+};
+
+enum class RayHitType : uint32_t { NONE, NODE, TRIANGLE, STATIC };
+
+// Body id of hits against the static environment
+constexpr uint32_t STATIC_BODY_ID = ~0u;
+
+struct RayHit {
+  RayHitType type = RayHitType::NONE;
+  // Node index for node hits, index into the scene-wide triangle list for
+  // triangle hits and into the environment's triangles for static hits
+  uint32_t index = 0;
+  uint32_t bodyId = 0;
+  float distance = FLT_MAX;
+  glm::vec3 position = glm::vec3(0.0f);
+  glm::vec3 normal = glm::vec3(0.0f);
+};
+
+// Ray casts against the node spheres and triangles of all bodies. Nodes and
+// triangles share one tree that is refitted as the bodies move and rebuilt
+// when the topology version changes or the tree degrades. Does not depend
+// on any render state, so it works headlessly.
+class SceneQuery {
+public:
+  // Rebuild the tree once refitting has made it this much more expensive
+  // to traverse than right after the last build
+  float rebuildQualityRatio = 1.5f;
+
+  // Rays are also cast against the environment's triangles, the
+  // environment has to outlive this
+  void setEnvironment(const StaticEnvironment* pEnvironment) {
+    this->_pEnvironment = pEnvironment;
+  }
+
+  // Takes the body id of each node and a version that changes along with
+  // the topology, as kept by BodyRegistry
+  void update(
+      const std::vector<Solver::Vertex>& vertices,
+      const std::vector<uint32_t>& triangles,
+      const std::vector<uint32_t>& nodeBodies,
+      uint64_t topologyVersion);
+
+  // Casts all rays in parallel against the state of the last update, hits
+  // line up with the rays
+  void raycast(const std::vector<Ray>& rays, std::vector<RayHit>& hits) const;
+  RayHit raycast(const Ray& ray) const;
+
+  void clear();
+
+  size_t getBytes() const;
+
+private:
+  const StaticEnvironment* _pEnvironment = nullptr;
+
+  // Topology the tree was built for
+  bool _hasTopology = false;
+  uint64_t _topologyVersion = 0;
+  uint32_t _nodeCount = 0;
+  std::vector<uint32_t> _triangles;
+  std::vector<uint32_t> _nodeBodies;
+
+  // Positions and radii as of the last update
+  std::vector<glm::vec3> _positions;
+  std::vector<float> _radii;
+
+  // Primitives [0, nodeCount) are node spheres, the rest are triangles
+  std::vector<Aabb> _bounds;
+  Bvh _bvh;
+};
+} // namespace PiesForAlthea
@@ -1,5 +1,17 @@
 #pragma once
 
+#include "AdaptiveStepper.h"
+#include "BodyRegistry.h"
+#include "ContinuousCollision.h"
+#include "DrawListBuilder.h"
+#include "FrameExporter.h"
+#include "FrameGovernor.h"
+#include "IndirectDrawBuffer.h"
+#include "MemoryReport.h"
+#include "SceneQuery.h"
+#include "StagingBuffer.h"
+#include "StaticEnvironment.h"
+
 #include <Althea/Application.h>
 #include <Althea/DrawContext.h>
 #include <Althea/DynamicVertexBuffer.h>
@@ -12,6 +24,8 @@
 
 #include <vector>
 #include <cstdint>
+#include <deque>
+#include <string>
 
 using namespace Pies;
 using namespace AltheaEngine;
@@ -37,9 +51,86 @@ public:
 
   void setCameraTransform(const glm::mat4& transform);
 
+  // Hidden bodies are left out of the indirect draw lists
+  void setBodyVisible(uint32_t bodyId, bool visible);
+
+  // The governor lowers maxSubsteps under load. Adaptive substeps need
+  // enabled to be set, substeps forced by continuous collision are capped
+  // either way.
+  void setAdaptiveStepOptions(const AdaptiveStepOptions& options);
+  const AdaptiveStepStats& getStepStats() const {
+    return this->_stepper.getStats();
+  }
+
+  // The governor lowers maxImpactSplits under load
+  void setContinuousCollisionOptions(
+      const ContinuousCollisionOptions& options);
+
+  // Solver and render-prep costs are measured every frame and quality is
+  // traded away as needed to stay within the governor's frame budget
+  void setFrameGovernorOptions(const FrameGovernorOptions& options);
+  // Costs are measured with this clock instead of the wall clock, e.g. to
+  // drive the governor deterministically
+  void setFrameGovernorClock(GovernorClock clock);
+  const FrameGovernor& getFrameGovernor() const { return this->_governor; }
+
+  // Spawns the body immediately if it fits in the memory budget, otherwise
+  // queues or rejects it depending on the budget settings
+  SpawnResult spawn(const SpawnRequest& request);
+
+  // Replaces the static environment that is drawn and hit by scene queries,
+  // the build() must already have been called on it. The solver only knows
+  // about the floor plane, so bodies pass through the environment.
+  void setEnvironment(StaticEnvironment&& environment);
+  const StaticEnvironment& getEnvironment() const {
+    return this->_environment;
+  }
+
+  // Casts rays against the node spheres and triangles of all bodies as of
+  // the last tick, hits line up with the rays
+  void raycast(const std::vector<Ray>& rays, std::vector<RayHit>& hits);
+
+  // Publishes the node positions of every tick into a shared memory segment
+  // for other processes to read, see FrameExportReader.h
+  bool startFrameExport(const std::string& name, uint32_t slotCount = 4);
+  void stopFrameExport() { this->_frameExporter.close(); }
+
+  MemoryReport getMemoryReport() const;
+  void setMemoryBudget(const MemoryBudget& budget);
+  size_t getPendingSpawnCount() const { return this->_pendingSpawns.size(); }
+
 private:
-  void _createRenderState(Application& app, VkCommandBuffer commandBuffer);
-  void _deferredDestroyRenderState(Application& app);
+  bool _createRenderState(Application& app, VkCommandBuffer commandBuffer);
+
+  // Per-body buffers are rebuilt whenever bodies are spawned or cleared,
+  // their uploads go through the staging ring and old buffers are released
+  // once the frames using them have retired. Returns false if some index
+  // data couldn't be staged, the affected buffers are left empty so they
+  // aren't drawn until the next attempt.
+  bool _createBodyBuffers(Application& app, VkCommandBuffer commandBuffer);
+  void _applyQualitySettings(Application& app, VkCommandBuffer commandBuffer);
+  void _deferredDestroyBodyBuffers();
+
+  struct DeviceIndexBuffer {
+    BufferAllocation allocation;
+    uint32_t indexCount = 0;
+  };
+  // The index count is left at zero if the indices couldn't be staged
+  DeviceIndexBuffer _uploadIndices(
+      Application& app,
+      VkCommandBuffer commandBuffer,
+      const std::vector<uint32_t>& indices);
+
+  size_t _getBytesPerNode() const;
+  size_t _getFootprintBytes(const BodyTopologySizes& sizes) const;
+  // Pessimistic if nothing of this kind has been spawned yet, the exact
+  // cost is only known once the first such body has been measured
+  size_t _estimateSpawnBytes(const SpawnParams& params) const;
+  // Includes the GPU buffers of bodies spawned since the last upload
+  size_t _getBudgetedBytes() const;
+  bool _fitsInBudget(const SpawnParams& params) const;
+  void _spawnNow(const SpawnRequest& request);
+  void _flushPendingSpawns();
 
   enum class ViewMode {
     TRIANGLES,
@@ -52,26 +143,69 @@ private:
   glm::mat4 _cameraTransform;
 
   Solver _solver;
+  BodyRegistry _bodies;
+  AdaptiveStepper _stepper;
+  // As set by the user, the governor may lower the max substeps from here
+  AdaptiveStepOptions _stepOptions{};
+  FrameGovernor _governor;
+  ContinuousCollision _ccd;
+  // As set by the user, the governor may lower the max impact splits from
+  // here
+  ContinuousCollisionOptions _ccdOptions{};
+
+  StaticEnvironment _environment;
+
+  // Only brought up to date when rays are cast
+  SceneQuery _sceneQuery;
+  bool _sceneQueryDirty = true;
+
+  FrameExporter _frameExporter;
+  // Bumped once for every time the solver flags its render state dirty
+  uint64_t _topologyVersion = 0;
+  bool _topologyChangeExported = false;
+
+  MemoryBudget _memoryBudget{};
+  std::deque<SpawnRequest> _pendingSpawns;
+
+  // Used as the fence value for the staging ring, a frame is known to be
+  // complete once its ring buffer slot comes around again
+  uint64_t _frameNumber = 0;
+  StagingBuffer _stagingBuffer;
+
   DynamicVertexBuffer<Solver::Vertex> _vertexBuffer;
-  IndexBuffer _linesIndexBuffer;
-  IndexBuffer _trianglesIndexBuffer;
+  DeviceIndexBuffer _linesIndexBuffer;
+  DeviceIndexBuffer _trianglesIndexBuffer;
+
+  DrawListBuilder _drawLists;
+  IndirectDrawBuffer _lineDraws;
+  IndirectDrawBuffer _triangleDraws;
+  IndirectDrawBuffer _nodeDraws;
   
   // For visualizing nodes with instancing
   struct Sphere {
     VertexBuffer<glm::vec3> vertexBuffer;
     IndexBuffer indexBuffer;
+    uint32_t resolution = 0;
 
     Sphere() = default;
-    Sphere(Application& app, VkCommandBuffer commandBuffer);
+    Sphere(
+        Application& app,
+        VkCommandBuffer commandBuffer,
+        uint32_t resolution = 50);
   };
   Sphere _sphere{};
 
+  // The floor quad followed by the environment's triangles
   struct StaticGeometry {
     VertexBuffer<Solver::Vertex> vertexBuffer;
 
     StaticGeometry() = default;
-    StaticGeometry(Application& app, VkCommandBuffer commandBuffer);
+    StaticGeometry(
+        Application& app,
+        VkCommandBuffer commandBuffer,
+        const StaticEnvironment& environment);
   };
   StaticGeometry _staticGeometry{};
+  bool _staticGeometryDirty = false;
 };
 } // namespace PiesForAlthea
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "StagingRing.h"
+
+#include <Althea/Allocator.h>
+#include <Althea/Application.h>
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+
+using namespace AltheaEngine;
+
+namespace PiesForAlthea {
+// Persistently mapped, host-visible upload buffer sub-allocated through a
+// StagingRing. Uploads are recorded into the caller's command buffer, so
+// nothing waits on the GPU.
+class StagingBuffer {
+public:
+  StagingBuffer() = default;
+  StagingBuffer(
+      Application& app,
+      VkCommandBuffer commandBuffer,
+      size_t capacity);
+  ~StagingBuffer();
+
+  StagingBuffer(StagingBuffer&& rhs);
+  StagingBuffer& operator=(StagingBuffer&& rhs);
+
+  // Copies the data into the ring and records a copy into the destination
+  // buffer followed by a barrier for the given consumer. Returns false if
+  // the ring is out of space.
+  bool upload(
+      VkCommandBuffer commandBuffer,
+      VkBuffer dstBuffer,
+      const void* pData,
+      size_t size,
+      VkPipelineStageFlags dstStageMask,
+      VkAccessFlags dstAccessMask);
+
+  StagingRing& getRing() { return this->_ring; }
+  const StagingRing& getRing() const { return this->_ring; }
+  size_t getCapacity() const { return this->_ring.getCapacity(); }
+
+private:
+  BufferAllocation _allocation;
+  void* _pMappedMemory = nullptr;
+  StagingRing _ring;
+};
+} // namespace PiesForAlthea
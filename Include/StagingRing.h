@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace PiesForAlthea {
+// Ring sub-allocator over a fixed size region, with allocations retired in
+// batches once the GPU is known to be done with them. Fence values are any
+// monotonically increasing counter (e.g. frame numbers) - everything
+// allocated or deferred between two calls to submit() is tagged with the
+// fence value passed to the second one, and released by retire() once that
+// value has completed.
+class StagingRing {
+public:
+  struct Allocation {
+    size_t offset;
+    size_t size;
+  };
+
+  StagingRing() = default;
+  explicit StagingRing(size_t capacity);
+
+  // Returns false if there isn't enough retired space left, allocations
+  // never straddle the end of the ring
+  bool allocate(size_t size, size_t alignment, Allocation& allocation);
+
+  // Runs the task once everything submitted so far has been retired
+  void deferDestroy(std::function<void()>&& task);
+
+  void submit(uint64_t fenceValue);
+  void retire(uint64_t completedFenceValue);
+
+  // Retires everything, including work that was never submitted. Only safe
+  // once the device is idle.
+  void retireAll();
+
+  size_t getCapacity() const { return this->_capacity; }
+  size_t getUsedBytes() const { return this->_usedBytes; }
+  size_t getInFlightBatchCount() const { return this->_batches.size(); }
+
+private:
+  struct Batch {
+    uint64_t fenceValue;
+    size_t bytes;
+    std::vector<std::function<void()>> deferredTasks;
+  };
+
+  size_t _capacity = 0;
+
+  // Live allocations occupy [_tail, _head) modulo capacity
+  size_t _head = 0;
+  size_t _tail = 0;
+  size_t _usedBytes = 0;
+
+  // Work since the last submit
+  size_t _pendingBytes = 0;
+  std::vector<std::function<void()>> _pendingTasks;
+
+  std::deque<Batch> _batches;
+};
+} // namespace PiesForAlthea
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Bvh.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PiesForAlthea {
+// Static triangle soup that is drawn and hit by scene queries, collected
+// from meshes and heightfields and indexed by a BVH built once after
+// loading. Bodies don't collide with it: Pies only resolves contacts
+// between nodes and against its floor plane, and has no way to take
+// external contacts. Ray casts only visit the triangles along the ray, so
+// their cost does not grow with the size of the environment. The built
+// environment can be cached to disk to skip parsing and building on the
+// next load.
+class StaticEnvironment {
+public:
+  // Meshes only become queryable once build() is called
+  void addMesh(
+      const std::vector<glm::vec3>& positions,
+      const std::vector<uint32_t>& indices,
+      const glm::mat4& transform = glm::mat4(1.0f));
+
+  // Only vertex positions and faces are read, polygons are fanned into
+  // triangles. Throws if the file can't be read or is malformed.
+  void addObj(
+      const std::string& path,
+      const glm::mat4& transform = glm::mat4(1.0f));
+
+  // Heights are row-major with width samples along x and depth samples
+  // along z, spaced evenly starting from origin
+  void addHeightfield(
+      const std::vector<float>& heights,
+      uint32_t width,
+      uint32_t depth,
+      const glm::vec3& origin,
+      float spacing);
+
+  void build();
+  void clear();
+
+  // Loads the OBJ through a binary cache next to it, the cache is rebuilt
+  // whenever the source file or the transform changes
+  static StaticEnvironment loadObjCached(
+      const std::string& objPath,
+      const std::string& cachePath,
+      const glm::mat4& transform = glm::mat4(1.0f));
+
+  // The key identifies the source the environment was built from, a cache
+  // with a different key is treated as stale
+  void writeCache(const std::string& path, const std::string& key) const;
+  bool readCache(const std::string& path, const std::string& key);
+
+  // Distance to the closest triangle along a unit direction, or maxDistance
+  // if nothing is hit
+  float raycast(
+      const glm::vec3& origin,
+      const glm::vec3& direction,
+      float maxDistance,
+      uint32_t& triangle) const;
+
+  bool empty() const { return this->_indices.empty(); }
+  const std::vector<glm::vec3>& getPositions() const {
+    return this->_positions;
+  }
+  const std::vector<uint32_t>& getIndices() const { return this->_indices; }
+  size_t getTriangleCount() const { return this->_indices.size() / 3; }
+  size_t getBytes() const;
+
+private:
+  std::vector<glm::vec3> _positions;
+  std::vector<uint32_t> _indices;
+  Bvh _bvh;
+};
+} // namespace PiesForAlthea
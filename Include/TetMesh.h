@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PiesForAlthea {
+// Tetrahedral mesh imported from TetGen (.node/.ele/.face) or Gmsh (.msh,
+// ASCII versions 2.2 and 4.1) files, along with the unique edges and
+// outward-facing boundary triangles used to render it. Files are memory
+// mapped and parsed in place, and the large TetGen sections are parsed in
+// parallel. The loaders throw if a file can't be read or is malformed.
+// Loaded meshes can't be simulated yet: Pies only builds bodies through its
+// own create* calls and can't take user-supplied nodes and constraints.
+class TetMesh {
+public:
+  // Takes the .node or .ele file, or the shared path without an extension.
+  // The .face file is optional, without it the boundary is derived from
+  // the tets.
+  static TetMesh loadTetGen(const std::string& path);
+  static TetMesh loadMsh(const std::string& path);
+
+  // Picks the loader by extension and goes through a binary cache, which
+  // is rebuilt whenever any of the source files change. The cache is
+  // written next to the source unless a path is given.
+  static TetMesh
+  loadCached(const std::string& path, const std::string& cachePath = "");
+
+  // The key identifies the source the mesh was loaded from, a cache with a
+  // different key is treated as stale
+  void writeCache(const std::string& path, const std::string& key) const;
+  bool readCache(const std::string& path, const std::string& key);
+
+  const std::vector<glm::vec3>& getPositions() const {
+    return this->_positions;
+  }
+  // Four node indices per tet
+  const std::vector<uint32_t>& getTets() const { return this->_tets; }
+  // Two node indices per edge, in the layout of Solver::getLines()
+  const std::vector<uint32_t>& getLines() const { return this->_lines; }
+  // Three node indices per boundary triangle, wound counter-clockwise when
+  // seen from outside, in the layout of Solver::getTriangles()
+  const std::vector<uint32_t>& getTriangles() const {
+    return this->_triangles;
+  }
+
+  size_t getNodeCount() const { return this->_positions.size(); }
+  size_t getTetCount() const { return this->_tets.size() / 4; }
+  size_t getBytes() const;
+
+private:
+  // Derives the edges, and the boundary if none was given, from the tets.
+  // Given boundary triangles are checked against the tets and re-wound.
+  void _buildTopology(bool hasTriangles);
+
+  std::vector<glm::vec3> _positions;
+  std::vector<uint32_t> _tets;
+  std::vector<uint32_t> _lines;
+  std::vector<uint32_t> _triangles;
+};
+} // namespace PiesForAlthea
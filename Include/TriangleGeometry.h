@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace PiesForAlthea {
+// Two-sided Moller-Trumbore, returns maxDistance on a miss
+inline float intersectRayTriangle(
+    const glm::vec3& origin,
+    const glm::vec3& direction,
+    const glm::vec3& a,
+    const glm::vec3& b,
+    const glm::vec3& c,
+    float maxDistance) {
+  glm::vec3 ab = b - a;
+  glm::vec3 ac = c - a;
+  glm::vec3 p = glm::cross(direction, ac);
+  float det = glm::dot(ab, p);
+  if (std::abs(det) < 1e-12f) {
+    return maxDistance;
+  }
+
+  float invDet = 1.0f / det;
+  glm::vec3 s = origin - a;
+  float u = glm::dot(s, p) * invDet;
+  if (u < 0.0f || u > 1.0f) {
+    return maxDistance;
+  }
+
+  glm::vec3 q = glm::cross(s, ab);
+  float v = glm::dot(direction, q) * invDet;
+  if (v < 0.0f || u + v > 1.0f) {
+    return maxDistance;
+  }
+
+  float t = glm::dot(ac, q) * invDet;
+  if (t < 0.0f) {
+    return maxDistance;
+  }
+
+  return std::min(t, maxDistance);
+}
+
+// Unit normal of triangle abc, or fallback if it is degenerate
+inline glm::vec3 getTriangleNormal(
+    const glm::vec3& a,
+    const glm::vec3& b,
+    const glm::vec3& c,
+    const glm::vec3& fallback) {
+  glm::vec3 normal = glm::cross(b - a, c - a);
+  float length = glm::length(normal);
+  return length > 0.0f ? normal / length : fallback;
+}
+} // namespace PiesForAlthea
@@ -0,0 +1,222 @@
+#include "AdaptiveStepper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace PiesForAlthea {
+AdaptiveStepper::AdaptiveStepper(const AdaptiveStepOptions& options)
+    : _options(options) {
+  this->_validateOptions();
+  this->_substeps = this->_options.minSubsteps;
+}
+
+const AdaptiveStepStats&
+AdaptiveStepper::step(Solver& solver, float timeStep) {
+  return this->step(
+      [&solver](float deltaTime) { solver.tick(deltaTime); },
+      solver.getVertices(),
+      timeStep);
+}
+
+const AdaptiveStepStats& AdaptiveStepper::step(
+    const std::function<void(float)>& tick,
+    const std::vector<Solver::Vertex>& vertices,
+    float timeStep) {
+  this->_stats = {};
+
+  // Spawned or cleared bodies always wake the scene
+  if (this->isAsleep() && vertices.size() == this->_sleepPositions.size() &&
+      ++this->_skippedSteps < this->_options.sleepInterval) {
+    this->_stats.asleep = true;
+    return this->_stats;
+  }
+  this->_skippedSteps = 0;
+
+  uint32_t requiredSubsteps =
+      std::min(this->_requiredSubsteps, this->_options.maxSubsteps);
+  this->_requiredSubsteps = 1;
+
+  if (this->_options.enabled) {
+    this->_substep(tick, vertices, timeStep, requiredSubsteps);
+  } else {
+    float substepSize = timeStep / static_cast<float>(requiredSubsteps);
+    for (uint32_t i = 0; i < requiredSubsteps; ++i) {
+      tick(substepSize);
+    }
+
+    this->_stats.substeps = requiredSubsteps;
+  }
+
+  this->_updateSleep(vertices, timeStep);
+  return this->_stats;
+}
+
+void AdaptiveStepper::reset() {
+  this->_prevPositions.clear();
+  this->_prevVelocities.clear();
+  this->_sleepPositions.clear();
+  this->_calmSteps = 0;
+  this->_skippedSteps = 0;
+  this->_substeps = this->_options.minSubsteps;
+  this->_requiredSubsteps = 1;
+  this->_stats = {};
+}
+
+void AdaptiveStepper::requestSubsteps(uint32_t substeps) {
+  this->_substeps = std::clamp(
+      std::max(this->_substeps, substeps),
+      this->_options.minSubsteps,
+      this->_options.maxSubsteps);
+}
+
+void AdaptiveStepper::requireSubsteps(uint32_t substeps) {
+  this->_requiredSubsteps = std::max(this->_requiredSubsteps, substeps);
+}
+
+void AdaptiveStepper::setOptions(const AdaptiveStepOptions& options) {
+  this->_options = options;
+  this->_validateOptions();
+  this->_substeps = std::clamp(
+      this->_substeps,
+      this->_options.minSubsteps,
+      this->_options.maxSubsteps);
+}
+
+bool AdaptiveStepper::isAsleep() const {
+  return this->_options.sleepSpeed > 0.0f &&
+         this->_calmSteps >= this->_options.sleepSteps &&
+         this->_requiredSubsteps <= 1;
+}
+
+float AdaptiveStepper::measureResidual(
+    const std::vector<Solver::Vertex>& vertices,
+    float deltaTime) {
+  // Bodies were added or removed, restart the motion history
+  if (vertices.size() != this->_prevPositions.size()) {
+    this->_prevPositions.resize(vertices.size());
+    this->_prevVelocities.assign(vertices.size(), glm::vec3(0.0f));
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      this->_prevPositions[i] = vertices[i].position;
+    }
+
+    return -1.0f;
+  }
+
+  glm::vec3 gravityDelta = this->_options.gravity * deltaTime;
+  float residual = 0.0f;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    const Solver::Vertex& vertex = vertices[i];
+    glm::vec3 velocity =
+        (vertex.position - this->_prevPositions[i]) / deltaTime;
+
+    // How far the node strayed from where its previous velocity and gravity
+    // would have taken it over this substep
+    float deviation =
+        glm::length(velocity - this->_prevVelocities[i] - gravityDelta) *
+        deltaTime;
+    residual = std::max(residual, deviation / std::max(vertex.radius, 1e-4f));
+
+    this->_prevPositions[i] = vertex.position;
+    this->_prevVelocities[i] = velocity;
+  }
+
+  return residual;
+}
+
+void AdaptiveStepper::_validateOptions() {
+  AdaptiveStepOptions& options = this->_options;
+  if (options.minSubsteps > options.maxSubsteps) {
+    std::swap(options.minSubsteps, options.maxSubsteps);
+  }
+  options.minSubsteps = std::max(options.minSubsteps, 1u);
+  options.maxSubsteps = std::max(options.maxSubsteps, 1u);
+  options.sleepInterval = std::max(options.sleepInterval, 1u);
+}
+
+void AdaptiveStepper::_substep(
+    const std::function<void(float)>& tick,
+    const std::vector<Solver::Vertex>& vertices,
+    float timeStep,
+    uint32_t requiredSubsteps) {
+  using Clock = std::chrono::steady_clock;
+
+  Clock::time_point startTime = Clock::now();
+  auto elapsedMs = [startTime]() {
+    return std::chrono::duration<float, std::milli>(Clock::now() - startTime)
+        .count();
+  };
+
+  uint32_t substeps = std::max(this->_substeps, requiredSubsteps);
+  float substepSize = timeStep / static_cast<float>(substeps);
+  float remainingTime = timeStep;
+  // Required substeps bound how long any single tick may be
+  float maxTickTime = timeStep / static_cast<float>(requiredSubsteps);
+
+  for (uint32_t i = 0; i < substeps; ++i) {
+    // Once converged or over budget, take the rest of the step in one tick
+    bool finishEarly =
+        (this->_stats.converged || this->_stats.budgetExceeded) &&
+        remainingTime <= maxTickTime;
+    bool lastSubstep = (i == substeps - 1) || finishEarly;
+    float dt = lastSubstep ? remainingTime : substepSize;
+
+    tick(dt);
+    remainingTime -= dt;
+    ++this->_stats.substeps;
+
+    float residual = this->measureResidual(vertices, dt);
+    this->_stats.residual = std::max(this->_stats.residual, residual);
+
+    if (lastSubstep) {
+      break;
+    }
+
+    if (residual >= 0.0f && residual < this->_options.tolerance) {
+      this->_stats.converged = true;
+    }
+
+    if (elapsedMs() > this->_options.timeBudgetMs) {
+      this->_stats.budgetExceeded = true;
+    }
+  }
+
+  this->_stats.elapsedMs = elapsedMs();
+
+  // Pick the substep count for the next step, with some hysteresis so the
+  // count doesn't oscillate around the tolerance
+  if (this->_stats.budgetExceeded) {
+    this->_substeps = std::max(this->_substeps / 2, this->_options.minSubsteps);
+  } else if (this->_stats.residual > this->_options.tolerance) {
+    this->_substeps = std::min(this->_substeps * 2, this->_options.maxSubsteps);
+  } else if (this->_stats.residual < 0.25f * this->_options.tolerance) {
+    this->_substeps = std::max(this->_substeps / 2, this->_options.minSubsteps);
+  }
+}
+
+void AdaptiveStepper::_updateSleep(
+    const std::vector<Solver::Vertex>& vertices,
+    float timeStep) {
+  if (vertices.size() != this->_sleepPositions.size()) {
+    this->_sleepPositions.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      this->_sleepPositions[i] = vertices[i].position;
+    }
+
+    this->_calmSteps = 0;
+    return;
+  }
+
+  // Compared as distances to avoid a division per node
+  float maxDistance = this->_options.sleepSpeed * timeStep;
+  bool calm = true;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    glm::vec3 motion = vertices[i].position - this->_sleepPositions[i];
+    calm = calm && glm::dot(motion, motion) <= maxDistance * maxDistance;
+    this->_sleepPositions[i] = vertices[i].position;
+  }
+
+  this->_calmSteps =
+      calm ? std::min(this->_calmSteps + 1, this->_options.sleepSteps) : 0;
+}
+} // namespace PiesForAlthea
@@ -0,0 +1,195 @@
+#include "BodyRegistry.h"
+
+#include <functional>
+#include <stdexcept>
+
+namespace PiesForAlthea {
+BodyTopologyKey::BodyTopologyKey(const SpawnParams& params)
+    : type(params.type), scale(params.scale) {}
+
+bool BodyTopologyKey::operator==(const BodyTopologyKey& other) const {
+  return this->type == other.type && this->scale == other.scale;
+}
+
+size_t BodyTopologyKeyHash::operator()(const BodyTopologyKey& key) const {
+  size_t hash = std::hash<uint32_t>()(static_cast<uint32_t>(key.type));
+  hash ^= std::hash<float>()(key.scale) + 0x9e3779b9 + (hash << 6) +
+          (hash >> 2);
+
+  return hash;
+}
+
+uint32_t BodyRegistry::spawn(Solver& solver, const SpawnRequest& request) {
+  const SpawnParams& params = request.params;
+  switch (params.type) {
+  case BodyType::TET_BOX:
+    return this->spawnTetBox(
+        solver,
+        request.translation,
+        params.scale,
+        request.initialVelocity,
+        params.stiffness,
+        params.mass,
+        params.pinned);
+  case BodyType::SHEET:
+    return this->spawnSheet(
+        solver,
+        request.translation,
+        params.scale,
+        params.mass,
+        params.stiffness);
+  case BodyType::BEND_SHEET:
+    return this->spawnBendSheet(
+        solver,
+        request.translation,
+        params.scale,
+        params.stiffness);
+  default:
+    throw std::runtime_error("Unknown body type in spawn request.");
+  }
+}
+
+uint32_t BodyRegistry::spawnTetBox(
+    Solver& solver,
+    const glm::vec3& translation,
+    float scale,
+    const glm::vec3& initialVelocity,
+    float stiffness,
+    float mass,
+    bool pinned) {
+  SpawnParams params{};
+  params.type = BodyType::TET_BOX;
+  params.scale = scale;
+  params.stiffness = stiffness;
+  params.mass = mass;
+  params.pinned = pinned;
+
+  return this->_spawn(solver, params, [&]() {
+    solver.createTetBox(
+        translation,
+        scale,
+        initialVelocity,
+        stiffness,
+        mass,
+        pinned);
+  });
+}
+
+uint32_t BodyRegistry::spawnSheet(
+    Solver& solver,
+    const glm::vec3& translation,
+    float scale,
+    float mass,
+    float stiffness) {
+  SpawnParams params{};
+  params.type = BodyType::SHEET;
+  params.scale = scale;
+  params.stiffness = stiffness;
+  params.mass = mass;
+
+  return this->_spawn(solver, params, [&]() {
+    solver.createSheet(translation, scale, mass, stiffness);
+  });
+}
+
+uint32_t BodyRegistry::spawnBendSheet(
+    Solver& solver,
+    const glm::vec3& translation,
+    float scale,
+    float stiffness) {
+  SpawnParams params{};
+  params.type = BodyType::BEND_SHEET;
+  params.scale = scale;
+  params.stiffness = stiffness;
+
+  return this->_spawn(solver, params, [&]() {
+    solver.createBendSheet(translation, scale, stiffness);
+  });
+}
+
+void BodyRegistry::clear() {
+  this->_bodies.clear();
+  this->_nodeBodies.clear();
+  this->_nodeCount = 0;
+  this->_lineIndexCount = 0;
+  this->_triangleIndexCount = 0;
+  ++this->_topologyVersion;
+}
+
+const BodyTopologySizes*
+BodyRegistry::findSizes(const SpawnParams& params) const {
+  auto it = this->_sizesLookup.find(BodyTopologyKey(params));
+  if (it == this->_sizesLookup.end()) {
+    return nullptr;
+  }
+
+  return &this->_sizes[it->second];
+}
+
+size_t BodyRegistry::getSizesBytes() const {
+  return this->_sizes.capacity() * sizeof(BodyTopologySizes);
+}
+
+size_t BodyRegistry::getBodyBytes() const {
+  return this->_bodies.capacity() * sizeof(BodyInstance) +
+         this->_nodeBodies.capacity() * sizeof(uint32_t);
+}
+
+template <typename TSpawnFn>
+uint32_t BodyRegistry::_spawn(
+    Solver& solver,
+    const SpawnParams& params,
+    TSpawnFn&& spawnFn) {
+  uint32_t firstNode = this->_nodeCount;
+  spawnFn();
+
+  // Draw ranges are derived from these sizes, so they have to match what
+  // the solver actually appended. The body is already in the solver at this
+  // point, a mismatch just gets its own entry rather than failing the spawn.
+  BodyTopologyKey key(params);
+  BodyTopologySizes measured = this->_measureSpawn(solver, key, firstNode);
+
+  uint32_t sizesId;
+  auto it = this->_sizesLookup.find(key);
+  if (it != this->_sizesLookup.end() &&
+      this->_sizes[it->second].nodeCount == measured.nodeCount &&
+      this->_sizes[it->second].lineIndexCount == measured.lineIndexCount &&
+      this->_sizes[it->second].triangleIndexCount ==
+          measured.triangleIndexCount) {
+    sizesId = it->second;
+  } else {
+    sizesId = static_cast<uint32_t>(this->_sizes.size());
+    this->_sizes.push_back(measured);
+    this->_sizesLookup[key] = sizesId;
+  }
+
+  uint32_t bodyId = static_cast<uint32_t>(this->_bodies.size());
+  this->_bodies.push_back({sizesId, firstNode});
+  this->_nodeBodies.resize(firstNode + measured.nodeCount, bodyId);
+
+  this->_nodeCount += measured.nodeCount;
+  this->_lineIndexCount += measured.lineIndexCount;
+  this->_triangleIndexCount += measured.triangleIndexCount;
+  ++this->_topologyVersion;
+
+  return bodyId;
+}
+
+BodyTopologySizes BodyRegistry::_measureSpawn(
+    const Solver& solver,
+    const BodyTopologyKey& key,
+    uint32_t firstNode) const {
+  // The solver appends the nodes, lines and triangles of a new body after
+  // those of all previously spawned bodies
+  BodyTopologySizes sizes{};
+  sizes.key = key;
+  sizes.nodeCount =
+      static_cast<uint32_t>(solver.getVertices().size()) - firstNode;
+  sizes.lineIndexCount = static_cast<uint32_t>(
+      solver.getLines().size() - this->_lineIndexCount);
+  sizes.triangleIndexCount = static_cast<uint32_t>(
+      solver.getTriangles().size() - this->_triangleIndexCount);
+
+  return sizes;
+}
+} // namespace PiesForAlthea
@@ -0,0 +1,335 @@
+#include "Bvh.h"
+
+#include "BinaryIO.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace PiesForAlthea {
+namespace {
+constexpr uint32_t SAH_BIN_COUNT = 12;
+
+// Keeps the traversal stack in Bvh::query bounded, anything deeper becomes a
+// (large) leaf
+constexpr uint32_t MAX_DEPTH = 48;
+
+struct BuildTask {
+  uint32_t node;
+  uint32_t begin;
+  uint32_t end;
+  uint32_t depth;
+};
+} // namespace
+
+void Bvh::build(const std::vector<Aabb>& primitiveBounds) {
+  this->clear();
+  if (primitiveBounds.empty()) {
+    return;
+  }
+
+  uint32_t primitiveCount = static_cast<uint32_t>(primitiveBounds.size());
+  this->_primitiveBounds = primitiveBounds;
+  this->_primitives.resize(primitiveCount);
+  std::vector<glm::vec3> centers(primitiveCount);
+  for (uint32_t i = 0; i < primitiveCount; ++i) {
+    this->_primitives[i] = i;
+    centers[i] = primitiveBounds[i].getCenter();
+  }
+
+  this->_nodes.reserve(2 * primitiveCount);
+  this->_nodes.emplace_back();
+
+  std::vector<BuildTask> tasks;
+  tasks.push_back({0, 0, primitiveCount, 0});
+  while (!tasks.empty()) {
+    BuildTask task = tasks.back();
+    tasks.pop_back();
+
+    if (this->_levels.size() <= task.depth) {
+      this->_levels.resize(task.depth + 1);
+    }
+    this->_levels[task.depth].push_back(task.node);
+
+    Aabb bounds;
+    Aabb centerBounds;
+    for (uint32_t i = task.begin; i < task.end; ++i) {
+      uint32_t primitive = this->_primitives[i];
+      bounds.expand(primitiveBounds[primitive]);
+      centerBounds.expand(centers[primitive]);
+    }
+    this->_nodes[task.node].bounds = bounds;
+
+    uint32_t count = task.end - task.begin;
+    if (count <= MAX_LEAF_SIZE || task.depth >= MAX_DEPTH) {
+      this->_nodes[task.node].first = task.begin;
+      this->_nodes[task.node].primitiveCount = count;
+      continue;
+    }
+
+    glm::vec3 extent = centerBounds.max - centerBounds.min;
+    int axis = 0;
+    if (extent.y > extent[axis]) {
+      axis = 1;
+    }
+    if (extent.z > extent[axis]) {
+      axis = 2;
+    }
+
+    auto beginIt = this->_primitives.begin() + task.begin;
+    auto endIt = this->_primitives.begin() + task.end;
+    auto midIt = beginIt;
+
+    if (extent[axis] > 0.0f) {
+      // Binned SAH along the axis with the widest spread of centers
+      float binScale = SAH_BIN_COUNT / extent[axis];
+      auto getBin = [&](uint32_t primitive) {
+        uint32_t bin = static_cast<uint32_t>(
+            (centers[primitive][axis] - centerBounds.min[axis]) * binScale);
+        return std::min(bin, SAH_BIN_COUNT - 1);
+      };
+
+      std::array<Aabb, SAH_BIN_COUNT> binBounds{};
+      std::array<uint32_t, SAH_BIN_COUNT> binCounts{};
+      for (auto it = beginIt; it != endIt; ++it) {
+        uint32_t bin = getBin(*it);
+        binBounds[bin].expand(primitiveBounds[*it]);
+        ++binCounts[bin];
+      }
+
+      // Sweep from the right to get the cost of every right-hand side
+      std::array<float, SAH_BIN_COUNT> rightCosts{};
+      Aabb rightBounds;
+      uint32_t rightCount = 0;
+      for (uint32_t bin = SAH_BIN_COUNT - 1; bin > 0; --bin) {
+        rightBounds.expand(binBounds[bin]);
+        rightCount += binCounts[bin];
+        rightCosts[bin] =
+            rightCount > 0 ? rightBounds.getSurfaceArea() * rightCount : 0.0f;
+      }
+
+      float bestCost = FLT_MAX;
+      uint32_t bestSplit = 0;
+      Aabb leftBounds;
+      uint32_t leftCount = 0;
+      for (uint32_t split = 1; split < SAH_BIN_COUNT; ++split) {
+        leftBounds.expand(binBounds[split - 1]);
+        leftCount += binCounts[split - 1];
+        if (leftCount == 0 || leftCount == count) {
+          continue;
+        }
+
+        float cost =
+            leftBounds.getSurfaceArea() * leftCount + rightCosts[split];
+        if (cost < bestCost) {
+          bestCost = cost;
+          bestSplit = split;
+        }
+      }
+
+      if (bestSplit > 0) {
+        midIt = std::partition(beginIt, endIt, [&](uint32_t primitive) {
+          return getBin(primitive) < bestSplit;
+        });
+      }
+    }
+
+    if (midIt == beginIt || midIt == endIt) {
+      // Coincident centers, fall back to splitting the range in half
+      midIt = beginIt + count / 2;
+      std::nth_element(
+          beginIt,
+          midIt,
+          endIt,
+          [&](uint32_t a, uint32_t b) {
+            return centers[a][axis] < centers[b][axis];
+          });
+    }
+
+    uint32_t mid = static_cast<uint32_t>(midIt - this->_primitives.begin());
+    uint32_t left = static_cast<uint32_t>(this->_nodes.size());
+    this->_nodes.emplace_back();
+    this->_nodes.emplace_back();
+    this->_nodes[task.node].first = left;
+    this->_nodes[task.node].primitiveCount = 0;
+
+    tasks.push_back({left, task.begin, mid, task.depth + 1});
+    tasks.push_back({left + 1, mid, task.end, task.depth + 1});
+  }
+
+  this->_cost = this->_computeCost();
+  this->_builtCost = this->_cost;
+}
+
+void Bvh::refit(const std::vector<Aabb>& primitiveBounds) {
+  if (primitiveBounds.size() != this->_primitiveBounds.size()) {
+    this->build(primitiveBounds);
+    return;
+  }
+
+  this->_primitiveBounds = primitiveBounds;
+
+  // Children always sit one level deeper than their parent, so finishing a
+  // level before starting the one above it is all the ordering needed
+  for (size_t depth = this->_levels.size(); depth-- > 0;) {
+    const std::vector<uint32_t>& level = this->_levels[depth];
+    parallelFor(level.size(), 1024, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        Node& node = this->_nodes[level[i]];
+        Aabb bounds;
+        if (node.primitiveCount > 0) {
+          for (uint32_t j = 0; j < node.primitiveCount; ++j) {
+            bounds.expand(
+                this->_primitiveBounds[this->_primitives[node.first + j]]);
+          }
+        } else {
+          bounds.expand(this->_nodes[node.first].bounds);
+          bounds.expand(this->_nodes[node.first + 1].bounds);
+        }
+
+        node.bounds = bounds;
+      }
+    });
+  }
+
+  this->_cost = this->_computeCost();
+}
+
+void Bvh::clear() {
+  this->_nodes.clear();
+  this->_primitives.clear();
+  this->_primitiveBounds.clear();
+  this->_levels.clear();
+  this->_cost = 0.0f;
+  this->_builtCost = 0.0f;
+}
+
+void Bvh::write(std::ostream& stream) const {
+  writeVector(stream, this->_nodes);
+  writeVector(stream, this->_primitives);
+  writeVector(stream, this->_primitiveBounds);
+  writeValue(stream, this->_builtCost);
+}
+
+bool Bvh::read(std::istream& stream) {
+  this->clear();
+  if (!readVector(stream, this->_nodes) ||
+      !readVector(stream, this->_primitives) ||
+      !readVector(stream, this->_primitiveBounds) ||
+      !readValue(stream, this->_builtCost)) {
+    this->clear();
+    return false;
+  }
+
+  uint32_t nodeCount = static_cast<uint32_t>(this->_nodes.size());
+  uint32_t primitiveCount = static_cast<uint32_t>(this->_primitives.size());
+  // Make sure traversal can't leave the arrays or loop. Children always
+  // come after their parent and every node but the root is the child of
+  // exactly one node, so each node is reached exactly once from the root.
+  std::vector<bool> reached(nodeCount, false);
+  if (nodeCount > 0) {
+    reached[0] = true;
+  }
+  for (uint32_t i = 0; i < nodeCount; ++i) {
+    const Node& node = this->_nodes[i];
+    bool valid = node.primitiveCount > 0
+                     ? node.first <= primitiveCount &&
+                           node.primitiveCount <= primitiveCount - node.first
+                     : node.first > i && node.first < nodeCount - 1 &&
+                           !reached[node.first] && !reached[node.first + 1];
+    if (!valid) {
+      this->clear();
+      return false;
+    }
+
+    if (node.primitiveCount == 0) {
+      reached[node.first] = true;
+      reached[node.first + 1] = true;
+    }
+  }
+
+  if (std::find(reached.begin(), reached.end(), false) != reached.end()) {
+    this->clear();
+    return false;
+  }
+
+  for (uint32_t primitive : this->_primitives) {
+    if (primitive >= this->_primitiveBounds.size()) {
+      this->clear();
+      return false;
+    }
+  }
+
+  if (!this->_buildLevels()) {
+    this->clear();
+    return false;
+  }
+
+  this->_cost = this->_computeCost();
+  return true;
+}
+
+size_t Bvh::getBytes() const {
+  size_t bytes = this->_nodes.capacity() * sizeof(Node) +
+                 this->_primitives.capacity() * sizeof(uint32_t) +
+                 this->_primitiveBounds.capacity() * sizeof(Aabb);
+  for (const std::vector<uint32_t>& level : this->_levels) {
+    bytes += level.capacity() * sizeof(uint32_t);
+  }
+
+  return bytes;
+}
+
+bool Bvh::_buildLevels() {
+  this->_levels.clear();
+  if (this->_nodes.empty()) {
+    return true;
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> stack;
+  stack.push_back({0, 0});
+  while (!stack.empty()) {
+    auto [node, depth] = stack.back();
+    stack.pop_back();
+
+    if (this->_levels.size() <= depth) {
+      this->_levels.resize(depth + 1);
+    }
+    this->_levels[depth].push_back(node);
+
+    if (this->_nodes[node].primitiveCount == 0) {
+      // Deeper trees would overflow the traversal stacks
+      if (depth >= MAX_DEPTH) {
+        return false;
+      }
+
+      stack.push_back({this->_nodes[node].first, depth + 1});
+      stack.push_back({this->_nodes[node].first + 1, depth + 1});
+    }
+  }
+
+  return true;
+}
+
+float Bvh::_computeCost() const {
+  if (this->_nodes.empty()) {
+    return 0.0f;
+  }
+
+  float rootArea = this->_nodes[0].bounds.getSurfaceArea();
+  if (rootArea <= 0.0f) {
+    return 0.0f;
+  }
+
+  // Unit traversal cost for internal nodes, unit intersection cost per
+  // primitive in a leaf
+  float cost = 0.0f;
+  for (const Node& node : this->_nodes) {
+    float area = node.bounds.getSurfaceArea();
+    cost += node.primitiveCount > 0 ? area * node.primitiveCount : area;
+  }
+
+  return cost / rootArea;
+}
+} // namespace PiesForAlthea
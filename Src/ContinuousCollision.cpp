@@ -0,0 +1,345 @@
+#include "ContinuousCollision.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace PiesForAlthea {
+namespace {
+uint64_t hashCell(int32_t x, int32_t y, int32_t z) {
+  // 21 bits per axis
+  constexpr uint64_t mask = (1 << 21) - 1;
+  return (static_cast<uint64_t>(x) & mask) |
+         ((static_cast<uint64_t>(y) & mask) << 21) |
+         ((static_cast<uint64_t>(z) & mask) << 42);
+}
+
+int32_t cellCoord(float x, float cellSize) {
+  return static_cast<int32_t>(std::floor(x / cellSize));
+}
+
+// Smallest t in [0, 1] at which a sphere starting at relative offset d
+// and moving by w over the step comes within distance r, or 1 if it never
+// does. Already overlapping pairs are left to the solver.
+float sweptSphereToi(const glm::vec3& d, const glm::vec3& w, float r) {
+  float c = glm::dot(d, d) - r * r;
+  if (c <= 0.0f) {
+    return 1.0f;
+  }
+
+  float a = glm::dot(w, w);
+  float b = -2.0f * glm::dot(d, w);
+  if (a <= 0.0f || b >= 0.0f) {
+    // Not moving towards each other
+    return 1.0f;
+  }
+
+  float discriminant = b * b - 4.0f * a * c;
+  if (discriminant < 0.0f) {
+    return 1.0f;
+  }
+
+  float t = (-b - std::sqrt(discriminant)) / (2.0f * a);
+  return std::clamp(t, 0.0f, 1.0f);
+}
+} // namespace
+
+ContinuousCollision::ContinuousCollision(
+    const ContinuousCollisionOptions& options)
+    : _options(options) {}
+
+void ContinuousCollision::seedNodes(
+    const std::vector<Solver::Vertex>& vertices,
+    uint32_t firstNode,
+    uint32_t nodeCount,
+    const glm::vec3& velocity) {
+  size_t end = static_cast<size_t>(firstNode) + nodeCount;
+  size_t prevCount = this->_prevPositions.size();
+  if (prevCount < end) {
+    this->_prevPositions.resize(end);
+    this->_velocities.resize(end, glm::vec3(0.0f));
+  }
+
+  // Any untracked nodes before this body are assumed to be resting
+  for (size_t i = prevCount; i < firstNode; ++i) {
+    this->_prevPositions[i] = vertices[i].position;
+  }
+
+  for (size_t i = firstNode; i < end; ++i) {
+    this->_prevPositions[i] = vertices[i].position;
+    this->_velocities[i] = velocity;
+  }
+}
+
+void ContinuousCollision::step(
+    Solver& solver,
+    AdaptiveStepper& stepper,
+    const std::vector<uint32_t>& nodeBodies,
+    float timeStep) {
+  this->step(
+      [&solver](float deltaTime) { solver.tick(deltaTime); },
+      solver.getVertices(),
+      stepper,
+      nodeBodies,
+      timeStep);
+}
+
+void ContinuousCollision::step(
+    const std::function<void(float)>& tick,
+    const std::vector<Solver::Vertex>& vertices,
+    AdaptiveStepper& stepper,
+    const std::vector<uint32_t>& nodeBodies,
+    float timeStep) {
+  float remainingTime = timeStep;
+  for (uint32_t i = 0; i < this->_options.maxImpactSplits; ++i) {
+    float toi = this->findEarliestImpact(vertices, nodeBodies, remainingTime);
+    if (toi >= 1.0f) {
+      break;
+    }
+
+    // Advance up to the impact, then take the rest of the step in substeps
+    // short enough that the fast nodes can't pass through anything
+    float deltaTime = toi * remainingTime;
+    if (deltaTime > 0.0f) {
+      stepper.step(tick, vertices, deltaTime);
+      this->recordStep(vertices, deltaTime);
+      remainingTime -= deltaTime;
+    }
+
+    stepper.requireSubsteps(this->_requiredSubsteps);
+  }
+
+  stepper.step(tick, vertices, remainingTime);
+  this->recordStep(vertices, remainingTime);
+}
+
+void ContinuousCollision::recordStep(
+    const std::vector<Solver::Vertex>& vertices,
+    float deltaTime) {
+  if (this->_prevPositions.size() != vertices.size()) {
+    // Nodes we were never told about, treat them as resting
+    this->reset();
+    this->_prevPositions.resize(vertices.size());
+    this->_velocities.resize(vertices.size(), glm::vec3(0.0f));
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      this->_prevPositions[i] = vertices[i].position;
+    }
+
+    return;
+  }
+
+  if (deltaTime <= 0.0f) {
+    return;
+  }
+
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    this->_velocities[i] =
+        (vertices[i].position - this->_prevPositions[i]) / deltaTime;
+    this->_prevPositions[i] = vertices[i].position;
+  }
+}
+
+void ContinuousCollision::reset() {
+  this->_prevPositions.clear();
+  this->_velocities.clear();
+  this->_fastNodes.clear();
+  this->_fastNodeCells.clear();
+  this->_isFast.clear();
+  this->_grid.clear();
+  this->_usedBuckets.clear();
+  this->_requiredSubsteps = 1;
+}
+
+float ContinuousCollision::findEarliestImpact(
+    const std::vector<Solver::Vertex>& vertices,
+    const std::vector<uint32_t>& nodeBodies,
+    float deltaTime) {
+  this->_fastNodes.clear();
+  this->_requiredSubsteps = 1;
+
+  if (!this->_options.enabled ||
+      this->_velocities.size() != vertices.size() ||
+      nodeBodies.size() != vertices.size()) {
+    return 1.0f;
+  }
+
+  // Cheap pass over all nodes, only fast nodes take the swept path
+  float maxSubsteps = 1.0f;
+  float maxRadius = 0.0f;
+  this->_isFast.assign(vertices.size(), 0);
+  for (uint32_t i = 0; i < vertices.size(); ++i) {
+    float displacement = glm::length(this->_velocities[i]) * deltaTime;
+    float radius = std::max(vertices[i].radius, 1e-4f);
+    maxRadius = std::max(maxRadius, radius);
+    if (displacement > this->_options.fastNodeThreshold * radius) {
+      this->_fastNodes.push_back(i);
+      this->_isFast[i] = 1;
+      maxSubsteps = std::max(maxSubsteps, std::ceil(displacement / radius));
+    }
+  }
+
+  if (this->_fastNodes.empty()) {
+    return 1.0f;
+  }
+
+  // Only bounds the conversion, the stepper caps the substeps it takes
+  this->_requiredSubsteps =
+      static_cast<uint32_t>(std::min(maxSubsteps, 65536.0f));
+
+  // Covers the contact distance of any two nodes plus the furthest a slow
+  // node can move over the step
+  float reach = (2.0f + this->_options.fastNodeThreshold) * maxRadius;
+  this->_buildGrid(vertices, deltaTime, reach);
+
+  float earliestToi = 1.0f;
+  for (uint32_t i : this->_fastNodes) {
+    const Solver::Vertex& vertex = vertices[i];
+    glm::vec3 motion = this->_velocities[i] * deltaTime;
+
+    // Floor plane
+    float clearance =
+        vertex.position.y - vertex.radius - this->_options.floorHeight;
+    if (clearance > 0.0f && motion.y < -clearance) {
+      earliestToi = std::min(earliestToi, clearance / -motion.y);
+    }
+  }
+
+  // Fast nodes look for each other through their own swept bounds, slow
+  // nodes only need to check the cell they are in
+  for (size_t k = 0; k < this->_fastNodes.size(); ++k) {
+    earliestToi = std::min(
+        earliestToi,
+        this->_sweepAgainstFastNodes(
+            vertices,
+            nodeBodies,
+            this->_fastNodes[k],
+            this->_fastNodeCells[k],
+            deltaTime));
+  }
+
+  for (uint32_t i = 0; i < vertices.size(); ++i) {
+    const glm::vec3& position = vertices[i].position;
+    if (this->_isFast[i] ||
+        glm::any(glm::lessThan(position, this->_sweptMin)) ||
+        glm::any(glm::greaterThan(position, this->_sweptMax))) {
+      continue;
+    }
+
+    earliestToi = std::min(
+        earliestToi,
+        this->_sweepAgainstFastNodes(
+            vertices,
+            nodeBodies,
+            i,
+            this->_getCellRange(position, position),
+            deltaTime));
+  }
+
+  return earliestToi;
+}
+
+ContinuousCollision::CellRange ContinuousCollision::_getCellRange(
+    const glm::vec3& min,
+    const glm::vec3& max) const {
+  float cellSize = this->_cellSize;
+  return {
+      cellCoord(min.x, cellSize),
+      cellCoord(min.y, cellSize),
+      cellCoord(min.z, cellSize),
+      cellCoord(max.x, cellSize),
+      cellCoord(max.y, cellSize),
+      cellCoord(max.z, cellSize)};
+}
+
+void ContinuousCollision::_buildGrid(
+    const std::vector<Solver::Vertex>& vertices,
+    float deltaTime,
+    float reach) {
+  // Buckets of cells that were swept before are reused, the map itself is
+  // only dropped once stale cells pile up
+  if (this->_grid.size() > 1024 &&
+      this->_grid.size() > 4 * this->_usedBuckets.size()) {
+    this->_grid.clear();
+  } else {
+    for (std::vector<uint32_t>* pBucket : this->_usedBuckets) {
+      pBucket->clear();
+    }
+  }
+  this->_usedBuckets.clear();
+
+  // Long sweeps get coarser cells, so that no fast node covers more than a
+  // handful of cells per axis
+  float maxMotion = 0.0f;
+  for (uint32_t i : this->_fastNodes) {
+    maxMotion = std::max(maxMotion, glm::length(this->_velocities[i]));
+  }
+  maxMotion *= deltaTime;
+  this->_cellSize = std::max({reach, 0.25f * maxMotion, 1e-3f});
+
+  this->_sweptMin = glm::vec3(FLT_MAX);
+  this->_sweptMax = glm::vec3(-FLT_MAX);
+  this->_fastNodeCells.resize(this->_fastNodes.size());
+  for (size_t k = 0; k < this->_fastNodes.size(); ++k) {
+    uint32_t i = this->_fastNodes[k];
+    glm::vec3 start = vertices[i].position;
+    glm::vec3 end = start + this->_velocities[i] * deltaTime;
+    glm::vec3 sweptMin = glm::min(start, end) - glm::vec3(reach);
+    glm::vec3 sweptMax = glm::max(start, end) + glm::vec3(reach);
+    this->_sweptMin = glm::min(this->_sweptMin, sweptMin);
+    this->_sweptMax = glm::max(this->_sweptMax, sweptMax);
+
+    const CellRange& cells = this->_fastNodeCells[k] =
+        this->_getCellRange(sweptMin, sweptMax);
+    for (int32_t x = cells.minX; x <= cells.maxX; ++x) {
+      for (int32_t y = cells.minY; y <= cells.maxY; ++y) {
+        for (int32_t z = cells.minZ; z <= cells.maxZ; ++z) {
+          std::vector<uint32_t>& bucket = this->_grid[hashCell(x, y, z)];
+          if (bucket.empty()) {
+            this->_usedBuckets.push_back(&bucket);
+          }
+
+          bucket.push_back(i);
+        }
+      }
+    }
+  }
+}
+
+float ContinuousCollision::_sweepAgainstFastNodes(
+    const std::vector<Solver::Vertex>& vertices,
+    const std::vector<uint32_t>& nodeBodies,
+    uint32_t node,
+    const CellRange& cells,
+    float deltaTime) const {
+  const Solver::Vertex& vertex = vertices[node];
+  glm::vec3 motion = this->_velocities[node] * deltaTime;
+
+  float earliestToi = 1.0f;
+  for (int32_t x = cells.minX; x <= cells.maxX; ++x) {
+    for (int32_t y = cells.minY; y <= cells.maxY; ++y) {
+      for (int32_t z = cells.minZ; z <= cells.maxZ; ++z) {
+        auto it = this->_grid.find(hashCell(x, y, z));
+        if (it == this->_grid.end()) {
+          continue;
+        }
+
+        for (uint32_t other : it->second) {
+          if (nodeBodies[other] == nodeBodies[node]) {
+            continue;
+          }
+
+          glm::vec3 relativeMotion =
+              motion - this->_velocities[other] * deltaTime;
+          float toi = sweptSphereToi(
+              vertices[other].position - vertex.position,
+              relativeMotion,
+              vertex.radius + vertices[other].radius);
+          earliestToi = std::min(earliestToi, toi);
+        }
+      }
+    }
+  }
+
+  return earliestToi;
+}
+} // namespace PiesForAlthea
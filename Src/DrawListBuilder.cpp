@@ -0,0 +1,121 @@
+#include "DrawListBuilder.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace PiesForAlthea {
+void DrawListBuilder::setBodies(const BodyRegistry& bodies) {
+  std::vector<BodyDrawRange> ranges;
+  ranges.reserve(bodies.getBodies().size());
+
+  // The solver appends index lists body by body, in spawn order
+  uint32_t firstLineIndex = 0;
+  uint32_t firstTriangleIndex = 0;
+  for (const BodyInstance& body : bodies.getBodies()) {
+    const BodyTopologySizes& sizes = bodies.getSizes(body.sizesId);
+
+    BodyDrawRange& range = ranges.emplace_back();
+    range.firstLineIndex = firstLineIndex;
+    range.lineIndexCount = sizes.lineIndexCount;
+    range.firstTriangleIndex = firstTriangleIndex;
+    range.triangleIndexCount = sizes.triangleIndexCount;
+    range.firstNode = body.firstNode;
+    range.nodeCount = sizes.nodeCount;
+
+    firstLineIndex += range.lineIndexCount;
+    firstTriangleIndex += range.triangleIndexCount;
+  }
+
+  this->setBodies(std::move(ranges));
+}
+
+void DrawListBuilder::setBodies(std::vector<BodyDrawRange>&& ranges) {
+  this->_ranges = std::move(ranges);
+  // Bodies that were already known keep their visibility
+  this->_visibility.resize(this->_ranges.size(), 1);
+}
+
+void DrawListBuilder::clear() {
+  this->_ranges.clear();
+  this->_visibility.clear();
+  this->_commands.clear();
+}
+
+void DrawListBuilder::setVisible(uint32_t bodyId, bool visible) {
+  // Bodies spawned since the last call to setBodies may be referenced too
+  if (bodyId >= this->_visibility.size()) {
+    this->_visibility.resize(bodyId + 1, 1);
+  }
+
+  this->_visibility[bodyId] = visible ? 1 : 0;
+}
+
+void DrawListBuilder::setAllVisible(bool visible) {
+  std::fill(this->_visibility.begin(), this->_visibility.end(), visible);
+}
+
+const std::vector<VkDrawIndexedIndirectCommand>&
+DrawListBuilder::build(DrawListType type, uint32_t sphereIndexCount) {
+  this->_commands.clear();
+
+  size_t bodyCount = std::min(this->_ranges.size(), this->_visibility.size());
+  for (size_t i = 0; i < bodyCount; ++i) {
+    const BodyDrawRange& range = this->_ranges[i];
+
+    uint32_t first;
+    uint32_t count;
+    switch (type) {
+    case DrawListType::LINES:
+      first = range.firstLineIndex;
+      count = range.lineIndexCount;
+      break;
+    case DrawListType::TRIANGLES:
+      first = range.firstTriangleIndex;
+      count = range.triangleIndexCount;
+      break;
+    case DrawListType::NODES:
+    default:
+      first = range.firstNode;
+      count = range.nodeCount;
+      break;
+    }
+
+    if (!this->_visibility[i] || count == 0) {
+      continue;
+    }
+
+    // Runs are only merged where the ranges are back to back, which also
+    // splits them around hidden bodies
+    if (!this->_commands.empty()) {
+      VkDrawIndexedIndirectCommand& command = this->_commands.back();
+      if (type == DrawListType::NODES &&
+          command.firstInstance + command.instanceCount == first) {
+        command.instanceCount += count;
+        continue;
+      }
+
+      if (type != DrawListType::NODES &&
+          command.firstIndex + command.indexCount == first) {
+        command.indexCount += count;
+        continue;
+      }
+    }
+
+    VkDrawIndexedIndirectCommand& command = this->_commands.emplace_back();
+    command.vertexOffset = 0;
+    if (type == DrawListType::NODES) {
+      command.indexCount = sphereIndexCount;
+      command.instanceCount = count;
+      command.firstIndex = 0;
+      command.firstInstance = first;
+    } else {
+      command.indexCount = count;
+      command.instanceCount = 1;
+      command.firstIndex = first;
+      command.firstInstance = 0;
+    }
+  }
+
+  return this->_commands;
+}
+} // namespace PiesForAlthea
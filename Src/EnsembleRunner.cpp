@@ -0,0 +1,269 @@
+#include "EnsembleRunner.h"
+
+#include "AdaptiveStepper.h"
+#include "BodyRegistry.h"
+#include "ContinuousCollision.h"
+#include "ParallelFor.h"
+
+#include <Pies/Solver.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace Pies;
+
+namespace PiesForAlthea {
+namespace {
+std::vector<float> parseList(const std::string& arg) {
+  std::vector<float> values;
+  std::stringstream stream(arg);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    values.push_back(std::stof(value));
+  }
+
+  if (values.empty()) {
+    throw std::runtime_error("Expected a comma separated list of values.");
+  }
+
+  return values;
+}
+
+std::string escapeCsv(const std::string& text) {
+  if (text.find_first_of(",\"\n") == std::string::npos) {
+    return text;
+  }
+
+  std::string escaped = "\"";
+  for (char c : text) {
+    if (c == '"') {
+      escaped += '"';
+    }
+    escaped += c;
+  }
+  escaped += '"';
+
+  return escaped;
+}
+} // namespace
+
+EnsembleRunner::EnsembleRunner(const EnsembleOptions& options)
+    : _options(options) {}
+
+const std::vector<EnsembleRunResult>& EnsembleRunner::run() {
+  struct Variant {
+    float stiffness;
+    float gridSpacing;
+    float launchSpeed;
+  };
+
+  std::vector<Variant> variants;
+  for (float stiffness : this->_options.stiffnesses) {
+    for (float gridSpacing : this->_options.gridSpacings) {
+      for (float launchSpeed : this->_options.launchSpeeds) {
+        variants.push_back({stiffness, gridSpacing, launchSpeed});
+      }
+    }
+  }
+
+  this->_results.clear();
+  this->_results.resize(variants.size());
+
+  size_t workerCount = this->_options.workerCount != 0
+                           ? this->_options.workerCount
+                           : getWorkerCount();
+  workerCount = std::min(workerCount, variants.size());
+
+  // Runs can take very different amounts of time, so workers pull the next
+  // variant as they finish instead of getting a fixed share
+  std::atomic<size_t> nextVariant = 0;
+  auto worker = [&]() {
+    for (size_t i = nextVariant++; i < variants.size(); i = nextVariant++) {
+      const Variant& variant = variants[i];
+      EnsembleRunResult& result = this->_results[i];
+      try {
+        result = this->_runVariant(
+            variant.stiffness,
+            variant.gridSpacing,
+            variant.launchSpeed);
+      } catch (const std::exception& e) {
+        result.error = e.what();
+      } catch (...) {
+        result.error = "Unknown error.";
+      }
+
+      result.stiffness = variant.stiffness;
+      result.gridSpacing = variant.gridSpacing;
+      result.launchSpeed = variant.launchSpeed;
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < workerCount; ++i) {
+    workers.emplace_back(worker);
+  }
+
+  for (std::thread& thread : workers) {
+    thread.join();
+  }
+
+  return this->_results;
+}
+
+uint32_t EnsembleRunner::getFailedRunCount() const {
+  return static_cast<uint32_t>(std::count_if(
+      this->_results.begin(),
+      this->_results.end(),
+      [](const EnsembleRunResult& result) { return !result.error.empty(); }));
+}
+
+void EnsembleRunner::writeResults() const {
+  std::ofstream file(this->_options.outputPath);
+  if (!file) {
+    throw std::runtime_error(
+        "Could not open ensemble results file: " + this->_options.outputPath);
+  }
+
+  file << "run,stiffness,gridSpacing,launchSpeed,nodeCount,steps,totalStepMs,"
+          "meanStepMs,maxStepMs,kineticEnergy,potentialEnergy,totalEnergy,"
+          "maxPenetration,error\n";
+
+  for (size_t i = 0; i < this->_results.size(); ++i) {
+    const EnsembleRunResult& result = this->_results[i];
+    file << i << "," << result.stiffness << "," << result.gridSpacing << ","
+         << result.launchSpeed << "," << result.nodeCount << ","
+         << this->_options.stepCount << "," << result.totalStepMs << ","
+         << result.totalStepMs / std::max(this->_options.stepCount, 1u)
+         << "," << result.maxStepMs << "," << result.kineticEnergy << ","
+         << result.potentialEnergy << ","
+         << result.kineticEnergy + result.potentialEnergy << ","
+         << result.maxPenetration << "," << escapeCsv(result.error) << "\n";
+  }
+}
+
+/*static*/
+EnsembleOptions EnsembleRunner::parseArgs(int argc, char** argv, int firstArg) {
+  EnsembleOptions options{};
+  for (int i = firstArg; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      throw std::runtime_error("Missing value for ensemble argument: " + arg);
+    }
+
+    std::string value = argv[++i];
+    if (arg == "--stiffness") {
+      options.stiffnesses = parseList(value);
+    } else if (arg == "--grid-spacing") {
+      options.gridSpacings = parseList(value);
+    } else if (arg == "--launch-speed") {
+      options.launchSpeeds = parseList(value);
+    } else if (arg == "--steps") {
+      options.stepCount = static_cast<uint32_t>(std::stoul(value));
+    } else if (arg == "--dt") {
+      options.timeStep = std::stof(value);
+    } else if (arg == "--workers") {
+      options.workerCount = static_cast<uint32_t>(std::stoul(value));
+    } else if (arg == "--out") {
+      options.outputPath = value;
+    } else {
+      throw std::runtime_error("Unknown ensemble argument: " + arg);
+    }
+  }
+
+  return options;
+}
+
+EnsembleRunResult EnsembleRunner::_runVariant(
+    float stiffness,
+    float gridSpacing,
+    float launchSpeed) const {
+  using Clock = std::chrono::steady_clock;
+
+  EnsembleRunResult result{};
+  result.stiffness = stiffness;
+  result.gridSpacing = gridSpacing;
+  result.launchSpeed = launchSpeed;
+
+  SolverOptions solverOptions{};
+  solverOptions.floorHeight = this->_options.floorHeight;
+  solverOptions.gridSpacing = gridSpacing;
+  Solver solver(solverOptions);
+
+  ContinuousCollisionOptions ccdOptions{};
+  ccdOptions.floorHeight = this->_options.floorHeight;
+  ContinuousCollision ccd(ccdOptions);
+  AdaptiveStepper stepper;
+  BodyRegistry bodies;
+
+  auto spawn = [&](const SpawnRequest& request) {
+    uint32_t bodyId = bodies.spawn(solver, request);
+    const BodyInstance& body = bodies.getBodies()[bodyId];
+    ccd.seedNodes(
+        solver.getVertices(),
+        body.firstNode,
+        bodies.getSizes(body.sizesId).nodeCount,
+        request.initialVelocity);
+  };
+
+  // Base scene: a resting box, a sheet dropped on top of it and a box
+  // launched into it from the side. Every body uses the swept stiffness.
+  // Boxes extend this far below their translation at unit scale.
+  float boxHalfHeight = 1.0f;
+
+  SpawnRequest restingBox{};
+  restingBox.params.type = BodyType::TET_BOX;
+  restingBox.params.stiffness = stiffness;
+  restingBox.translation =
+      glm::vec3(0.0f, this->_options.floorHeight + boxHalfHeight, 0.0f);
+  spawn(restingBox);
+
+  SpawnRequest sheet{};
+  sheet.params.type = BodyType::SHEET;
+  sheet.params.stiffness = stiffness;
+  sheet.translation = glm::vec3(0.0f, this->_options.floorHeight + 4.0f, 0.0f);
+  spawn(sheet);
+
+  SpawnRequest launchedBox{};
+  launchedBox.params.type = BodyType::TET_BOX;
+  launchedBox.params.stiffness = stiffness;
+  launchedBox.translation =
+      glm::vec3(-10.0f, this->_options.floorHeight + boxHalfHeight, 0.0f);
+  launchedBox.initialVelocity = glm::vec3(launchSpeed, 0.0f, 0.0f);
+  spawn(launchedBox);
+
+  for (uint32_t step = 0; step < this->_options.stepCount; ++step) {
+    Clock::time_point start = Clock::now();
+    ccd.step(solver, stepper, bodies.getNodeBodies(), this->_options.timeStep);
+    double stepMs =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+
+    result.totalStepMs += stepMs;
+    result.maxStepMs = std::max(result.maxStepMs, stepMs);
+
+    for (const Solver::Vertex& vertex : solver.getVertices()) {
+      float penetration =
+          this->_options.floorHeight - (vertex.position.y - vertex.radius);
+      result.maxPenetration = std::max(result.maxPenetration, penetration);
+    }
+  }
+
+  const std::vector<Solver::Vertex>& vertices = solver.getVertices();
+  const std::vector<glm::vec3>& velocities = ccd.getVelocities();
+  result.nodeCount = static_cast<uint32_t>(vertices.size());
+  for (size_t i = 0; i < vertices.size() && i < velocities.size(); ++i) {
+    result.kineticEnergy += 0.5 * glm::dot(velocities[i], velocities[i]);
+    result.potentialEnergy +=
+        this->_options.gravity *
+        (vertices[i].position.y - this->_options.floorHeight);
+  }
+
+  return result;
+}
+} // namespace PiesForAlthea
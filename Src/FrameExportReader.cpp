@@ -0,0 +1,165 @@
+#include "FrameExportReader.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace PiesForAlthea {
+namespace {
+// How many times to chase the writer before giving up on a read
+constexpr uint32_t MAX_READ_ATTEMPTS = 8;
+} // namespace
+
+FrameExportReader::~FrameExportReader() { this->close(); }
+
+bool FrameExportReader::open(const std::string& name) {
+  this->close();
+
+#ifdef _WIN32
+  return false;
+#else
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(FrameExportHeader)) {
+    ::close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(info.st_size);
+  void* pSegment = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (pSegment == MAP_FAILED) {
+    return false;
+  }
+
+  // The writer may still be setting up the header, in which case the magic
+  // won't match yet and the caller tries again later
+  const FrameExportHeader* pHeader =
+      static_cast<const FrameExportHeader*>(pSegment);
+  if (pHeader->magic != FRAME_EXPORT_MAGIC ||
+      pHeader->version != FRAME_EXPORT_VERSION || pHeader->slotCount == 0 ||
+      pHeader->slotStride !=
+          getFrameExportSlotStride(pHeader->nodeCapacity) ||
+      getFrameExportSize(pHeader->slotCount, pHeader->nodeCapacity) > size) {
+    munmap(pSegment, size);
+    return false;
+  }
+
+  this->_name = name;
+  this->_pSegment = pSegment;
+  this->_segmentSize = size;
+  return true;
+#endif
+}
+
+void FrameExportReader::close() {
+  if (!this->isOpen()) {
+    return;
+  }
+
+#ifndef _WIN32
+  munmap(this->_pSegment, this->_segmentSize);
+#endif
+  this->_pSegment = nullptr;
+  this->_segmentSize = 0;
+}
+
+FrameReadStatus FrameExportReader::beginRead(FrameView& view) const {
+  if (!this->isOpen()) {
+    return FrameReadStatus::CLOSED;
+  }
+
+  FrameExportHeader* pHeader =
+      static_cast<FrameExportHeader*>(this->_pSegment);
+  for (uint32_t attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt) {
+    if (pHeader->closed.load(std::memory_order_acquire)) {
+      return FrameReadStatus::CLOSED;
+    }
+
+    uint64_t publishedFrames =
+        pHeader->publishedFrames.load(std::memory_order_acquire);
+    if (publishedFrames == 0) {
+      return FrameReadStatus::NO_FRAME;
+    }
+
+    uint64_t frameIndex = publishedFrames - 1;
+    FrameExportSlot* pSlot = getFrameExportSlot(
+        this->_pSegment,
+        static_cast<uint32_t>(frameIndex % pHeader->slotCount));
+    uint64_t sequence = pSlot->sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      // The writer has lapped the ring and is refilling this slot already
+      continue;
+    }
+
+    view.pNodes = getFrameExportNodes(pSlot);
+    view.nodeCount = pSlot->nodeCount;
+    view.frameIndex = pSlot->frameIndex;
+    view.topologyVersion = pSlot->topologyVersion;
+    view.pSlot = pSlot;
+    view.sequence = sequence;
+
+    // Anything read above may be torn, so check before handing out a node
+    // count that could point past the slot
+    if (!this->endRead(view) || view.frameIndex != frameIndex ||
+        view.nodeCount > pHeader->nodeCapacity) {
+      continue;
+    }
+
+    return FrameReadStatus::OK;
+  }
+
+  return FrameReadStatus::RETRY;
+}
+
+bool FrameExportReader::endRead(const FrameView& view) const {
+  // Keeps the reads of the frame from moving past the sequence check
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return view.pSlot != nullptr &&
+         view.pSlot->sequence.load(std::memory_order_relaxed) ==
+             view.sequence;
+}
+
+bool FrameExportReader::readLatest(
+    std::vector<FrameExportNode>& nodes,
+    uint64_t& frameIndex,
+    uint64_t& topologyVersion) {
+  for (uint32_t attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt) {
+    FrameView view;
+    FrameReadStatus status = this->beginRead(view);
+    if (status == FrameReadStatus::CLOSED) {
+      std::string name = this->_name;
+      if (!this->open(name)) {
+        return false;
+      }
+
+      continue;
+    }
+
+    if (status == FrameReadStatus::NO_FRAME) {
+      return false;
+    }
+
+    if (status == FrameReadStatus::RETRY) {
+      continue;
+    }
+
+    nodes.assign(view.pNodes, view.pNodes + view.nodeCount);
+    if (this->endRead(view)) {
+      frameIndex = view.frameIndex;
+      topologyVersion = view.topologyVersion;
+      return true;
+    }
+  }
+
+  return false;
+}
+} // namespace PiesForAlthea
@@ -0,0 +1,167 @@
+#include "FrameExporter.h"
+
+#include <algorithm>
+#include <new>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace PiesForAlthea {
+FrameExporter::~FrameExporter() { this->close(); }
+
+bool FrameExporter::open(const std::string& name, uint32_t slotCount) {
+  this->close();
+
+#ifdef _WIN32
+  return false;
+#else
+  // Readers need at least one complete slot while the next one is written
+  this->_name = name;
+  this->_slotCount = std::max(slotCount, 2u);
+  this->_frameIndex = 0;
+  if (!this->_createSegment(1024)) {
+    this->_name.clear();
+    return false;
+  }
+
+  return true;
+#endif
+}
+
+void FrameExporter::close() {
+  if (!this->isOpen()) {
+    return;
+  }
+
+  this->_releaseSegment();
+#ifndef _WIN32
+  shm_unlink(this->_name.c_str());
+#endif
+  this->_name.clear();
+}
+
+void FrameExporter::publish(
+    const std::vector<Solver::Vertex>& vertices,
+    uint64_t topologyVersion) {
+  if (!this->isOpen()) {
+    return;
+  }
+
+  FrameExportHeader* pHeader =
+      static_cast<FrameExportHeader*>(this->_pSegment);
+  uint32_t nodeCount = static_cast<uint32_t>(vertices.size());
+  if (nodeCount > pHeader->nodeCapacity) {
+    // Readers hold on to the old mapping until they notice it was closed,
+    // so it can't be resized in place
+    uint32_t nodeCapacity = pHeader->nodeCapacity;
+    while (nodeCapacity < nodeCount) {
+      nodeCapacity *= 2;
+    }
+
+    this->_releaseSegment();
+    if (!this->_createSegment(nodeCapacity)) {
+      this->_name.clear();
+      return;
+    }
+
+    pHeader = static_cast<FrameExportHeader*>(this->_pSegment);
+  }
+
+  uint64_t frameIndex = this->_frameIndex++;
+  FrameExportSlot* pSlot = getFrameExportSlot(
+      this->_pSegment,
+      static_cast<uint32_t>(frameIndex % this->_slotCount));
+
+  // Odd sequence while writing, readers that overlap with this discard
+  // what they read
+  uint64_t sequence = pSlot->sequence.load(std::memory_order_relaxed);
+  pSlot->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  pSlot->frameIndex = frameIndex;
+  pSlot->topologyVersion = topologyVersion;
+  pSlot->nodeCount = nodeCount;
+  FrameExportNode* pNodes = getFrameExportNodes(pSlot);
+  for (uint32_t i = 0; i < nodeCount; ++i) {
+    const Solver::Vertex& vertex = vertices[i];
+    pNodes[i].position[0] = vertex.position.x;
+    pNodes[i].position[1] = vertex.position.y;
+    pNodes[i].position[2] = vertex.position.z;
+    pNodes[i].radius = vertex.radius;
+  }
+
+  pSlot->sequence.store(sequence + 2, std::memory_order_release);
+  pHeader->publishedFrames.store(frameIndex + 1, std::memory_order_release);
+}
+
+bool FrameExporter::_createSegment(uint32_t nodeCapacity) {
+#ifdef _WIN32
+  return false;
+#else
+  uint64_t size = getFrameExportSize(this->_slotCount, nodeCapacity);
+
+  // Start from a fresh object so readers still mapping an old one are not
+  // affected by the resize
+  shm_unlink(this->_name.c_str());
+  int fd = shm_open(this->_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    ::close(fd);
+    shm_unlink(this->_name.c_str());
+    return false;
+  }
+
+  void* pSegment = mmap(
+      nullptr,
+      static_cast<size_t>(size),
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED,
+      fd,
+      0);
+  ::close(fd);
+  if (pSegment == MAP_FAILED) {
+    shm_unlink(this->_name.c_str());
+    return false;
+  }
+
+  // ftruncate zero-fills, so only the header and the slot counters need to
+  // be constructed
+  FrameExportHeader* pHeader = new (pSegment) FrameExportHeader;
+  pHeader->magic = FRAME_EXPORT_MAGIC;
+  pHeader->version = FRAME_EXPORT_VERSION;
+  pHeader->slotCount = this->_slotCount;
+  pHeader->nodeCapacity = nodeCapacity;
+  pHeader->slotStride = getFrameExportSlotStride(nodeCapacity);
+  pHeader->closed.store(0, std::memory_order_relaxed);
+  for (uint32_t i = 0; i < this->_slotCount; ++i) {
+    FrameExportSlot* pSlot = new (getFrameExportSlot(pSegment, i))
+        FrameExportSlot;
+    pSlot->sequence.store(0, std::memory_order_relaxed);
+  }
+
+  // Readers only look at the slots once something has been published
+  pHeader->publishedFrames.store(0, std::memory_order_release);
+
+  this->_pSegment = pSegment;
+  this->_segmentSize = static_cast<size_t>(size);
+  return true;
+#endif
+}
+
+void FrameExporter::_releaseSegment() {
+#ifndef _WIN32
+  FrameExportHeader* pHeader =
+      static_cast<FrameExportHeader*>(this->_pSegment);
+  pHeader->closed.store(1, std::memory_order_release);
+  munmap(this->_pSegment, this->_segmentSize);
+#endif
+  this->_pSegment = nullptr;
+  this->_segmentSize = 0;
+}
+} // namespace PiesForAlthea
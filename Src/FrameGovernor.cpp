@@ -0,0 +1,138 @@
+#include "FrameGovernor.h"
+
+#include <array>
+#include <chrono>
+#include <utility>
+
+namespace PiesForAlthea {
+namespace {
+const std::array<QualitySettings, 5> QUALITY_LEVELS = {{
+    {1, 4, 50},
+    {2, 4, 32},
+    {4, 2, 24},
+    {8, 1, 16},
+    {8, 1, 8},
+}};
+
+double steadyClockMs() {
+  using Clock = std::chrono::steady_clock;
+  return std::chrono::duration<double, std::milli>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+} // namespace
+
+FrameGovernor::FrameGovernor() : _clock(steadyClockMs) {}
+
+FrameGovernor::FrameGovernor(
+    const FrameGovernorOptions& options,
+    GovernorClock clock)
+    : _options(options),
+      _clock(clock ? std::move(clock) : GovernorClock(steadyClockMs)) {}
+
+bool FrameGovernor::endFrame() {
+  float solverMs = this->_solverMs;
+  float renderPrepMs = this->_renderPrepMs;
+  this->_solverMs = 0.0f;
+  this->_renderPrepMs = 0.0f;
+  ++this->_frame;
+
+  float frameMs = solverMs + renderPrepMs;
+  if (!this->_hasSample) {
+    this->_smoothedMs = frameMs;
+    this->_hasSample = true;
+  } else {
+    this->_smoothedMs +=
+        this->_options.smoothing * (frameMs - this->_smoothedMs);
+  }
+
+  if (!this->_options.enabled) {
+    if (this->_level != 0) {
+      this->_setLevel(0, solverMs, renderPrepMs);
+      return true;
+    }
+
+    return false;
+  }
+
+  float target = this->_options.targetFrameMs;
+  if (this->_smoothedMs > this->_options.degradeRatio * target) {
+    ++this->_overBudgetFrames;
+    this->_underBudgetFrames = 0;
+  } else if (this->_smoothedMs < this->_options.recoverRatio * target) {
+    ++this->_underBudgetFrames;
+    this->_overBudgetFrames = 0;
+  } else {
+    this->_overBudgetFrames = 0;
+    this->_underBudgetFrames = 0;
+  }
+
+  if (this->_overBudgetFrames >= this->_options.degradeFrames &&
+      this->_level + 1 < getLevelCount()) {
+    this->_setLevel(this->_level + 1, solverMs, renderPrepMs);
+    return true;
+  }
+
+  if (this->_underBudgetFrames >= this->_options.recoverFrames &&
+      this->_level > 0) {
+    this->_setLevel(this->_level - 1, solverMs, renderPrepMs);
+    return true;
+  }
+
+  return false;
+}
+
+void FrameGovernor::setOptions(const FrameGovernorOptions& options) {
+  this->_options = options;
+  this->_overBudgetFrames = 0;
+  this->_underBudgetFrames = 0;
+  this->_trimLog();
+}
+
+void FrameGovernor::setClock(GovernorClock clock) {
+  this->_clock = clock ? std::move(clock) : GovernorClock(steadyClockMs);
+}
+
+const QualitySettings& FrameGovernor::getSettings() const {
+  return QUALITY_LEVELS[this->_level];
+}
+
+/*static*/
+uint32_t FrameGovernor::getLevelCount() {
+  return static_cast<uint32_t>(QUALITY_LEVELS.size());
+}
+
+void FrameGovernor::_setLevel(
+    uint32_t level,
+    float solverMs,
+    float renderPrepMs) {
+  GovernorDecision decision{};
+  decision.frame = this->_frame;
+  decision.fromLevel = this->_level;
+  decision.toLevel = level;
+  decision.smoothedMs = this->_smoothedMs;
+  decision.solverMs = solverMs;
+  decision.renderPrepMs = renderPrepMs;
+
+  this->_log.push_back(decision);
+  this->_trimLog();
+
+  this->_level = level;
+
+  // The new level has to prove itself before the next decision, without
+  // the smoothed cost of the old level carrying over
+  this->_overBudgetFrames = 0;
+  this->_underBudgetFrames = 0;
+  this->_hasSample = false;
+}
+
+void FrameGovernor::_trimLog() {
+  if (this->_options.maxLogSize == 0) {
+    return;
+  }
+
+  while (this->_log.size() > this->_options.maxLogSize) {
+    this->_log.pop_front();
+  }
+}
+} // namespace PiesForAlthea
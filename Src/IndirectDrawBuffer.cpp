@@ -0,0 +1,127 @@
+#include "IndirectDrawBuffer.h"
+
+#include <Althea/BufferUtilities.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace PiesForAlthea {
+IndirectDrawBuffer::IndirectDrawBuffer(
+    Application& app,
+    VkCommandBuffer commandBuffer,
+    uint32_t maxDrawCount)
+    : _maxDrawCount(std::max(maxDrawCount, 1u)) {
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+  allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+
+  this->_allocation = BufferUtilities::createBuffer(
+      app,
+      commandBuffer,
+      this->getSize(),
+      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+      allocInfo);
+  this->_pMappedMemory = this->_allocation.mapMemory();
+}
+
+IndirectDrawBuffer::~IndirectDrawBuffer() {
+  if (this->_pMappedMemory) {
+    this->_allocation.unmapMemory();
+    this->_pMappedMemory = nullptr;
+  }
+}
+
+IndirectDrawBuffer::IndirectDrawBuffer(IndirectDrawBuffer&& rhs)
+    : _allocation(std::move(rhs._allocation)),
+      _pMappedMemory(rhs._pMappedMemory),
+      _maxDrawCount(rhs._maxDrawCount) {
+  std::copy(
+      std::begin(rhs._drawCounts),
+      std::end(rhs._drawCounts),
+      std::begin(this->_drawCounts));
+  std::move(
+      std::begin(rhs._cpuDraws),
+      std::end(rhs._cpuDraws),
+      std::begin(this->_cpuDraws));
+  rhs._pMappedMemory = nullptr;
+  rhs._maxDrawCount = 0;
+}
+
+IndirectDrawBuffer& IndirectDrawBuffer::operator=(IndirectDrawBuffer&& rhs) {
+  if (this->_pMappedMemory) {
+    this->_allocation.unmapMemory();
+  }
+
+  this->_allocation = std::move(rhs._allocation);
+  this->_pMappedMemory = rhs._pMappedMemory;
+  this->_maxDrawCount = rhs._maxDrawCount;
+  std::copy(
+      std::begin(rhs._drawCounts),
+      std::end(rhs._drawCounts),
+      std::begin(this->_drawCounts));
+  std::move(
+      std::begin(rhs._cpuDraws),
+      std::end(rhs._cpuDraws),
+      std::begin(this->_cpuDraws));
+
+  rhs._pMappedMemory = nullptr;
+  rhs._maxDrawCount = 0;
+
+  return *this;
+}
+
+void IndirectDrawBuffer::updateDraws(
+    uint32_t ringBufferIndex,
+    const std::vector<VkDrawIndexedIndirectCommand>& draws) {
+  if (!this->_pMappedMemory) {
+    return;
+  }
+
+  uint32_t drawCount =
+      std::min(static_cast<uint32_t>(draws.size()), this->_maxDrawCount);
+  this->_drawCounts[ringBufferIndex] = drawCount;
+
+  size_t regionOffset = static_cast<size_t>(ringBufferIndex) *
+                        this->_maxDrawCount *
+                        sizeof(VkDrawIndexedIndirectCommand);
+  std::memcpy(
+      reinterpret_cast<char*>(this->_pMappedMemory) + regionOffset,
+      draws.data(),
+      drawCount * sizeof(VkDrawIndexedIndirectCommand));
+
+  this->_cpuDraws[ringBufferIndex].assign(
+      draws.begin(),
+      draws.begin() + drawCount);
+}
+
+void IndirectDrawBuffer::draw(
+    VkCommandBuffer commandBuffer,
+    uint32_t ringBufferIndex) const {
+  VkDeviceSize offset = static_cast<VkDeviceSize>(ringBufferIndex) *
+                        this->_maxDrawCount *
+                        sizeof(VkDrawIndexedIndirectCommand);
+  for (const VkDrawIndexedIndirectCommand& command :
+       this->_cpuDraws[ringBufferIndex]) {
+    // Indirect commands may only start at instance zero without
+    // drawIndirectFirstInstance
+    if (command.firstInstance != 0) {
+      vkCmdDrawIndexed(
+          commandBuffer,
+          command.indexCount,
+          command.instanceCount,
+          command.firstIndex,
+          command.vertexOffset,
+          command.firstInstance);
+    } else {
+      vkCmdDrawIndexedIndirect(
+          commandBuffer,
+          this->_allocation.getBuffer(),
+          offset,
+          1,
+          sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    offset += sizeof(VkDrawIndexedIndirectCommand);
+  }
+}
+} // namespace PiesForAlthea
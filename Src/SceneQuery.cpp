@@ -0,0 +1,230 @@
+#include "SceneQuery.h"
+
+#include "ParallelFor.h"
+#include "TriangleGeometry.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace PiesForAlthea {
+namespace {
+// Nearest entry distance of the ray into the sphere, or maxDistance if it
+// misses. Rays starting inside a sphere hit it at distance zero.
+float intersectSphere(
+    const glm::vec3& origin,
+    const glm::vec3& direction,
+    const glm::vec3& center,
+    float radius,
+    float maxDistance) {
+  glm::vec3 offset = origin - center;
+  float c = glm::dot(offset, offset) - radius * radius;
+  if (c <= 0.0f) {
+    return 0.0f;
+  }
+
+  float a = glm::dot(direction, direction);
+  float b = glm::dot(offset, direction);
+  if (b >= 0.0f) {
+    return maxDistance;
+  }
+
+  float discriminant = b * b - a * c;
+  if (discriminant < 0.0f) {
+    return maxDistance;
+  }
+
+  float t = (-b - std::sqrt(discriminant)) / a;
+  return std::min(t, maxDistance);
+}
+} // namespace
+
+void SceneQuery::update(
+    const std::vector<Solver::Vertex>& vertices,
+    const std::vector<uint32_t>& triangles,
+    const std::vector<uint32_t>& nodeBodies,
+    uint64_t topologyVersion) {
+  if (vertices.size() < nodeBodies.size()) {
+    // The registry is ahead of the solver, keep the last state
+    return;
+  }
+
+  bool topologyChanged =
+      !this->_hasTopology || topologyVersion != this->_topologyVersion;
+  if (topologyChanged) {
+    this->_hasTopology = true;
+    this->_topologyVersion = topologyVersion;
+    this->_nodeCount = static_cast<uint32_t>(nodeBodies.size());
+    this->_triangles = triangles;
+    this->_nodeBodies = nodeBodies;
+  }
+
+  uint32_t nodeCount = this->_nodeCount;
+  size_t triangleCount = this->_triangles.size() / 3;
+  this->_positions.resize(nodeCount);
+  this->_radii.resize(nodeCount);
+  this->_bounds.resize(nodeCount + triangleCount);
+
+  parallelFor(nodeCount, 4096, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      this->_positions[i] = vertices[i].position;
+      this->_radii[i] = vertices[i].radius;
+
+      Aabb bounds;
+      bounds.expand(vertices[i].position);
+      bounds.inflate(vertices[i].radius);
+      this->_bounds[i] = bounds;
+    }
+  });
+
+  parallelFor(triangleCount, 4096, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Aabb bounds;
+      bounds.expand(vertices[this->_triangles[3 * i + 0]].position);
+      bounds.expand(vertices[this->_triangles[3 * i + 1]].position);
+      bounds.expand(vertices[this->_triangles[3 * i + 2]].position);
+      this->_bounds[nodeCount + i] = bounds;
+    }
+  });
+
+  if (topologyChanged ||
+      this->_bvh.getPrimitiveCount() != this->_bounds.size()) {
+    this->_bvh.build(this->_bounds);
+  } else {
+    this->_bvh.refit(this->_bounds);
+    if (this->_bvh.getQualityRatio() > this->rebuildQualityRatio) {
+      this->_bvh.build(this->_bounds);
+    }
+  }
+}
+
+void SceneQuery::raycast(
+    const std::vector<Ray>& rays,
+    std::vector<RayHit>& hits) const {
+  hits.resize(rays.size());
+  parallelFor(rays.size(), 64, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      hits[i] = this->raycast(rays[i]);
+    }
+  });
+}
+
+RayHit SceneQuery::raycast(const Ray& ray) const {
+  RayHit hit{};
+  if (glm::dot(ray.direction, ray.direction) <= 0.0f) {
+    return hit;
+  }
+
+  // Work with a unit direction so that distances are in world units
+  glm::vec3 direction = glm::normalize(ray.direction);
+  uint32_t nodeCount = this->_nodeCount;
+  uint32_t closest = 0;
+  float distance = this->_bvh.raycast(
+      ray.origin,
+      direction,
+      ray.maxDistance,
+      [&](uint32_t primitive, float maxDistance) {
+        float t;
+        if (primitive < nodeCount) {
+          t = intersectSphere(
+              ray.origin,
+              direction,
+              this->_positions[primitive],
+              this->_radii[primitive],
+              maxDistance);
+        } else {
+          const uint32_t* pTriangle =
+              &this->_triangles[3 * (primitive - nodeCount)];
+          t = intersectRayTriangle(
+              ray.origin,
+              direction,
+              this->_positions[pTriangle[0]],
+              this->_positions[pTriangle[1]],
+              this->_positions[pTriangle[2]],
+              maxDistance);
+        }
+
+        if (t < maxDistance) {
+          closest = primitive;
+        }
+
+        return t;
+      });
+
+  if (this->_pEnvironment) {
+    uint32_t triangle = 0;
+    float staticDistance = this->_pEnvironment->raycast(
+        ray.origin,
+        direction,
+        std::min(distance, ray.maxDistance),
+        triangle);
+    if (staticDistance < std::min(distance, ray.maxDistance)) {
+      const std::vector<glm::vec3>& positions =
+          this->_pEnvironment->getPositions();
+      const uint32_t* pTriangle =
+          &this->_pEnvironment->getIndices()[3 * triangle];
+      glm::vec3 normal = getTriangleNormal(
+          positions[pTriangle[0]],
+          positions[pTriangle[1]],
+          positions[pTriangle[2]],
+          -direction);
+
+      hit.type = RayHitType::STATIC;
+      hit.index = triangle;
+      hit.bodyId = STATIC_BODY_ID;
+      hit.distance = staticDistance;
+      hit.position = ray.origin + staticDistance * direction;
+      hit.normal = glm::dot(normal, direction) > 0.0f ? -normal : normal;
+      return hit;
+    }
+  }
+
+  if (distance >= ray.maxDistance) {
+    return hit;
+  }
+
+  hit.distance = distance;
+  hit.position = ray.origin + distance * direction;
+  if (closest < nodeCount) {
+    hit.type = RayHitType::NODE;
+    hit.index = closest;
+    hit.bodyId = this->_nodeBodies[closest];
+    glm::vec3 offset = hit.position - this->_positions[closest];
+    float length = glm::length(offset);
+    hit.normal = length > 0.0f ? offset / length : -direction;
+  } else {
+    uint32_t triangle = closest - nodeCount;
+    const uint32_t* pTriangle = &this->_triangles[3 * triangle];
+    hit.type = RayHitType::TRIANGLE;
+    hit.index = triangle;
+    hit.bodyId = this->_nodeBodies[pTriangle[0]];
+
+    const glm::vec3& a = this->_positions[pTriangle[0]];
+    const glm::vec3& b = this->_positions[pTriangle[1]];
+    const glm::vec3& c = this->_positions[pTriangle[2]];
+    glm::vec3 normal = getTriangleNormal(a, b, c, -direction);
+    // Face the ray
+    hit.normal = glm::dot(normal, direction) > 0.0f ? -normal : normal;
+  }
+
+  return hit;
+}
+
+void SceneQuery::clear() {
+  this->_hasTopology = false;
+  this->_nodeCount = 0;
+  this->_triangles.clear();
+  this->_nodeBodies.clear();
+  this->_positions.clear();
+  this->_radii.clear();
+  this->_bounds.clear();
+  this->_bvh.clear();
+}
+
+size_t SceneQuery::getBytes() const {
+  return (this->_triangles.capacity() + this->_nodeBodies.capacity()) *
+             sizeof(uint32_t) +
+         this->_positions.capacity() * sizeof(glm::vec3) +
+         this->_radii.capacity() * sizeof(float) +
+         this->_bounds.capacity() * sizeof(Aabb) + this->_bvh.getBytes();
+}
+} // namespace PiesForAlthea
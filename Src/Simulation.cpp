@@ -1,9 +1,16 @@
 #include "Simulation.h"
 
+#include "ParallelFor.h"
+
+#include <Althea/BufferUtilities.h>
 #include <Althea/FrameContext.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
 using namespace Pies;
 using namespace AltheaEngine;
 
@@ -104,58 +111,75 @@ Simulation::Simulation() {
   solverOptions.gridSpacing = 1.0f;
 
   this->_solver = Solver(solverOptions);
-  this->_solver.createTetBox(
-        glm::vec3(-10.0f, 5.0f, 0.0f),
-        1.0f,
-        glm::vec3(0.0f),
-        1000.0,
-        1.0f,
-        false);
+
+  ContinuousCollisionOptions ccdOptions{};
+  ccdOptions.floorHeight = solverOptions.floorHeight;
+  this->setContinuousCollisionOptions(ccdOptions);
+
+  SpawnRequest request{};
+  request.params.type = BodyType::TET_BOX;
+  request.params.stiffness = 1000.0f;
+  request.translation = glm::vec3(-10.0f, 5.0f, 0.0f);
+  this->_spawnNow(request);
 }
 
 void Simulation::initInputBindings(InputManager& inputManager) {
   inputManager.addKeyBinding({GLFW_KEY_C, GLFW_PRESS, 0}, [this]() {
     this->_solver.clear();
+    this->_bodies.clear();
+    this->_stepper.reset();
+    this->_ccd.reset();
+    this->_drawLists.clear();
+    this->_sceneQuery.clear();
+    this->_sceneQueryDirty = true;
+    this->_topologyChangeExported = false;
+    // Queued spawns are kept, they are the ones that now fit
   });
   
   inputManager.addKeyBinding({GLFW_KEY_V, GLFW_PRESS, 0}, [this]() {
     glm::vec3 cameraPos = glm::vec3(this->_cameraTransform[3]);
     glm::vec3 cameraForward = -glm::vec3(this->_cameraTransform[2]);
-    this->_solver.createTetBox(
-        cameraPos + 10.0f * cameraForward,
-        1.0f,
-        glm::vec3(0.0f),
-        1000.0,
-        1.0f,
-        true);
+
+    SpawnRequest request{};
+    request.params.type = BodyType::TET_BOX;
+    request.params.stiffness = 1000.0f;
+    request.params.pinned = true;
+    request.translation = cameraPos + 10.0f * cameraForward;
+    this->spawn(request);
   });
 
   inputManager.addKeyBinding({GLFW_KEY_B, GLFW_PRESS, 0}, [this]() {
     glm::vec3 cameraPos = glm::vec3(this->_cameraTransform[3]);
     glm::vec3 cameraForward = -glm::vec3(this->_cameraTransform[2]);
-    this->_solver.createTetBox(
-        cameraPos + 10.0f * cameraForward,
-        1.0f,
-        15.0f * cameraForward,
-        1000.0f,
-        1.0f,
-        false);
+
+    SpawnRequest request{};
+    request.params.type = BodyType::TET_BOX;
+    request.params.stiffness = 1000.0f;
+    request.translation = cameraPos + 10.0f * cameraForward;
+    request.initialVelocity = 15.0f * cameraForward;
+    this->spawn(request);
   });
 
   inputManager.addKeyBinding({GLFW_KEY_N, GLFW_PRESS, 0}, [this]() {
     glm::vec3 cameraPos = glm::vec3(this->_cameraTransform[3]);
     glm::vec3 cameraForward = -glm::vec3(this->_cameraTransform[2]);
-    this->_solver.createSheet(
-        cameraPos + 10.0f * cameraForward,
-        1.0f,
-        1.0f,
-        10000.0f);
+
+    SpawnRequest request{};
+    request.params.type = BodyType::SHEET;
+    request.params.stiffness = 10000.0f;
+    request.translation = cameraPos + 10.0f * cameraForward;
+    this->spawn(request);
   });
 
   inputManager.addKeyBinding({GLFW_KEY_M, GLFW_PRESS, 0}, [this]() {
     glm::vec3 cameraPos = glm::vec3(this->_cameraTransform[3]);
     glm::vec3 cameraForward = -glm::vec3(this->_cameraTransform[2]);
-    this->_solver.createBendSheet(cameraPos + 10.0f * cameraForward, 1.0f, 100000.0f);
+
+    SpawnRequest request{};
+    request.params.type = BodyType::BEND_SHEET;
+    request.params.stiffness = 100000.0f;
+    request.translation = cameraPos + 10.0f * cameraForward;
+    this->spawn(request);
   });
 
   inputManager.addKeyBinding({GLFW_KEY_1, GLFW_PRESS, 0}, [this]() {
@@ -168,55 +192,131 @@ void Simulation::initInputBindings(InputManager& inputManager) {
 }
 
 void Simulation::tick(Application& app, float /*deltaTime*/) {
-  this->_solver.tick(0.05f);
+  double startMs = this->_governor.now();
+
+  this->_flushPendingSpawns();
+
+  constexpr float timeStep = 0.05f;
+  this->_ccd.step(
+      this->_solver,
+      this->_stepper,
+      this->_bodies.getNodeBodies(),
+      timeStep);
+
+  this->_sceneQueryDirty = true;
+
+  if (this->_frameExporter.isOpen()) {
+    // The flag stays set until the next preDraw, which may be several ticks
+    // away, so only count it once
+    if (this->_solver.renderStateDirty && !this->_topologyChangeExported) {
+      ++this->_topologyVersion;
+      this->_topologyChangeExported = true;
+    }
+
+    this->_frameExporter.publish(
+        this->_solver.getVertices(),
+        this->_topologyVersion);
+  }
+
+  this->_governor.addSolverMs(this->_governor.now() - startMs);
 }
 
 void Simulation::preDraw(Application& app, VkCommandBuffer commandBuffer) {
+  // A frame runs from one preDraw to the next, so this closes out the last
+  // render prep and the tick that just ran
+  if (this->_governor.endFrame()) {
+    this->_applyQualitySettings(app, commandBuffer);
+  }
+
+  double startMs = this->_governor.now();
+
+  if (this->_frameNumber >= MAX_FRAMES_IN_FLIGHT) {
+    this->_stagingBuffer.getRing().retire(
+        this->_frameNumber - MAX_FRAMES_IN_FLIGHT);
+  }
+
+  if (this->_staticGeometryDirty) {
+    StaticGeometry* pOldStaticGeometry =
+        new StaticGeometry(std::move(this->_staticGeometry));
+    this->_stagingBuffer.getRing().deferDestroy(
+        [pOldStaticGeometry]() { delete pOldStaticGeometry; });
+
+    this->_staticGeometry =
+        StaticGeometry(app, commandBuffer, this->_environment);
+    this->_staticGeometryDirty = false;
+  }
+
   if (this->_solver.renderStateDirty) {
-    this->_deferredDestroyRenderState(app);
-    this->_createRenderState(app, commandBuffer);
-    this->_solver.renderStateDirty = false;
+    this->_deferredDestroyBodyBuffers();
+    // Retried on the next frame if the upload failed
+    this->_solver.renderStateDirty =
+        !this->_createBodyBuffers(app, commandBuffer);
+    this->_topologyChangeExported = false;
   }
 
+  uint32_t ringBufferIndex = app.getCurrentFrameRingBufferIndex();
   this->_vertexBuffer.updateVertices(
-      app.getCurrentFrameRingBufferIndex(),
+      ringBufferIndex,
       this->_solver.getVertices());
+
+  // Lines are drawn in every view mode, the other lists only need to be
+  // rebuilt when they can be drawn this frame
+  this->_lineDraws.updateDraws(
+      ringBufferIndex,
+      this->_drawLists.build(DrawListType::LINES));
+
+  if (this->_viewMode == ViewMode::TRIANGLES) {
+    this->_triangleDraws.updateDraws(
+        ringBufferIndex,
+        this->_drawLists.build(DrawListType::TRIANGLES));
+  } else if (this->_viewMode == ViewMode::NODES) {
+    this->_nodeDraws.updateDraws(
+        ringBufferIndex,
+        this->_drawLists.build(
+            DrawListType::NODES,
+            static_cast<uint32_t>(this->_sphere.indexBuffer.getIndexCount())));
+  }
+
+  this->_stagingBuffer.getRing().submit(this->_frameNumber);
+  ++this->_frameNumber;
+
+  this->_governor.addRenderPrepMs(this->_governor.now() - startMs);
 }
 
 void Simulation::drawLines(const DrawContext& context) const {
-  if (this->_linesIndexBuffer.getIndexCount() == 0) {
+  if (this->_linesIndexBuffer.indexCount == 0) {
     return;
   }
 
   context.bindDescriptorSets();
-  context.bindIndexBuffer(this->_linesIndexBuffer);
+  vkCmdBindIndexBuffer(
+      context.getCommandBuffer(),
+      this->_linesIndexBuffer.allocation.getBuffer(),
+      0,
+      VK_INDEX_TYPE_UINT32);
   this->_vertexBuffer.bind(
       context.getFrame().frameRingBufferIndex,
       context.getCommandBuffer());
-  vkCmdDrawIndexed(
+  this->_lineDraws.draw(
       context.getCommandBuffer(),
-      static_cast<uint32_t>(this->_linesIndexBuffer.getIndexCount()),
-      1,
-      0,
-      0,
-      0);
+      context.getFrame().frameRingBufferIndex);
 }
 
 void Simulation::drawTriangles(const DrawContext& context) const {
   if (this->_viewMode == ViewMode::TRIANGLES &&
-      this->_trianglesIndexBuffer.getIndexCount() > 0) {
+      this->_trianglesIndexBuffer.indexCount > 0) {
     context.bindDescriptorSets();
-    context.bindIndexBuffer(this->_trianglesIndexBuffer);
+    vkCmdBindIndexBuffer(
+        context.getCommandBuffer(),
+        this->_trianglesIndexBuffer.allocation.getBuffer(),
+        0,
+        VK_INDEX_TYPE_UINT32);
     this->_vertexBuffer.bind(
         context.getFrame().frameRingBufferIndex,
         context.getCommandBuffer());
-    vkCmdDrawIndexed(
+    this->_triangleDraws.draw(
         context.getCommandBuffer(),
-        static_cast<uint32_t>(this->_trianglesIndexBuffer.getIndexCount()),
-        1,
-        0,
-        0,
-        0);
+        context.getFrame().frameRingBufferIndex);
   }
 
   context.bindDescriptorSets();
@@ -249,52 +349,209 @@ void Simulation::drawNodes(const DrawContext& context) const {
       2,
       vertexBuffers,
       offsets);
-  vkCmdDrawIndexed(
+  this->_nodeDraws.draw(
       context.getCommandBuffer(),
-      static_cast<uint32_t>(this->_sphere.indexBuffer.getIndexCount()),
-      this->_vertexBuffer.getVertexCount(),
-      0,
-      0,
-      0);
+      context.getFrame().frameRingBufferIndex);
 }
 
 void Simulation::setCameraTransform(const glm::mat4& transform) {
   this->_cameraTransform = transform;
 }
 
+void Simulation::setBodyVisible(uint32_t bodyId, bool visible) {
+  this->_drawLists.setVisible(bodyId, visible);
+}
+
+void Simulation::setAdaptiveStepOptions(const AdaptiveStepOptions& options) {
+  this->_stepOptions = options;
+
+  AdaptiveStepOptions governedOptions = options;
+  governedOptions.maxSubsteps = std::max(
+      options.maxSubsteps / this->_governor.getSettings().substepDivisor,
+      options.minSubsteps);
+  this->_stepper.setOptions(governedOptions);
+}
+
+void Simulation::setContinuousCollisionOptions(
+    const ContinuousCollisionOptions& options) {
+  this->_ccdOptions = options;
+
+  ContinuousCollisionOptions governedOptions = options;
+  governedOptions.maxImpactSplits = std::min(
+      options.maxImpactSplits,
+      this->_governor.getSettings().maxImpactSplits);
+  this->_ccd.setOptions(governedOptions);
+}
+
+void Simulation::setFrameGovernorOptions(const FrameGovernorOptions& options) {
+  this->_governor.setOptions(options);
+}
+
+void Simulation::setFrameGovernorClock(GovernorClock clock) {
+  this->_governor.setClock(std::move(clock));
+}
+
+SpawnResult Simulation::spawn(const SpawnRequest& request) {
+  // Keep queued spawns in order
+  if (this->_pendingSpawns.empty() && this->_fitsInBudget(request.params)) {
+    this->_spawnNow(request);
+    return SpawnResult::SPAWNED;
+  }
+
+  // Spawns that can never fit would hold up the queue for good
+  if (this->_memoryBudget.queueOverBudget &&
+      this->_pendingSpawns.size() < this->_memoryBudget.maxPendingSpawns &&
+      this->_estimateSpawnBytes(request.params) <=
+          this->_memoryBudget.maxBytes) {
+    this->_pendingSpawns.push_back(request);
+    return SpawnResult::QUEUED;
+  }
+
+  return SpawnResult::REJECTED;
+}
+
+void Simulation::setEnvironment(StaticEnvironment&& environment) {
+  this->_environment = std::move(environment);
+  this->_sceneQuery.setEnvironment(&this->_environment);
+  this->_sceneQueryDirty = true;
+  this->_staticGeometryDirty = true;
+}
+
+bool Simulation::startFrameExport(
+    const std::string& name,
+    uint32_t slotCount) {
+  // Readers can't know what they missed, so start them off on a new
+  // topology
+  ++this->_topologyVersion;
+  this->_topologyChangeExported = this->_solver.renderStateDirty;
+  return this->_frameExporter.open(name, slotCount);
+}
+
+void Simulation::raycast(
+    const std::vector<Ray>& rays,
+    std::vector<RayHit>& hits) {
+  if (this->_sceneQueryDirty) {
+    this->_sceneQuery.update(
+        this->_solver.getVertices(),
+        this->_solver.getTriangles(),
+        this->_bodies.getNodeBodies(),
+        this->_bodies.getTopologyVersion());
+    this->_sceneQueryDirty = false;
+  }
+
+  this->_sceneQuery.raycast(rays, hits);
+}
+
+MemoryReport Simulation::getMemoryReport() const {
+  MemoryReport report{};
+
+  size_t nodeCount = this->_solver.getVertices().size();
+  report.solverVertexBytes = nodeCount * sizeof(Solver::Vertex);
+  report.solverInternalBytes =
+      nodeCount * this->_memoryBudget.solverBytesPerNode;
+  report.stepperHistoryBytes = nodeCount * 2 * sizeof(glm::vec3);
+  report.topologySizesBytes = this->_bodies.getSizesBytes();
+  report.bodyBytes = this->_bodies.getBodyBytes();
+  report.sceneQueryBytes = this->_sceneQuery.getBytes();
+  report.environmentBytes = this->_environment.getBytes();
+
+  report.ringBufferMultiplier = MAX_FRAMES_IN_FLIGHT;
+  report.vertexBufferBytes = report.ringBufferMultiplier *
+                             this->_vertexBuffer.getVertexCount() *
+                             sizeof(Solver::Vertex);
+  report.linesIndexBufferBytes =
+      this->_linesIndexBuffer.indexCount * sizeof(uint32_t);
+  report.trianglesIndexBufferBytes =
+      this->_trianglesIndexBuffer.indexCount * sizeof(uint32_t);
+  report.stagingBytes = this->_stagingBuffer.getCapacity();
+  report.indirectDrawBytes = this->_lineDraws.getSize() +
+                             this->_triangleDraws.getSize() +
+                             this->_nodeDraws.getSize();
+  report.sphereBytes =
+      this->_sphere.vertexBuffer.getVertexCount() * sizeof(glm::vec3) +
+      this->_sphere.indexBuffer.getIndexCount() * sizeof(uint32_t);
+  report.staticGeometryBytes =
+      this->_staticGeometry.vertexBuffer.getVertexCount() *
+      sizeof(Solver::Vertex);
+
+  for (const BodyInstance& body : this->_bodies.getBodies()) {
+    const BodyTopologySizes& sizes = this->_bodies.getSizes(body.sizesId);
+    size_t type = static_cast<size_t>(sizes.key.type);
+
+    ++report.bodyCounts[type];
+    report.bodyTypeBytes[type] += this->_getFootprintBytes(sizes);
+  }
+
+  return report;
+}
+
+void Simulation::setMemoryBudget(const MemoryBudget& budget) {
+  this->_memoryBudget = budget;
+
+  // Spawns queued under the old limits are spawned, queued or rejected
+  // again under the new ones
+  std::deque<SpawnRequest> pendingSpawns;
+  pendingSpawns.swap(this->_pendingSpawns);
+  for (const SpawnRequest& request : pendingSpawns) {
+    this->spawn(request);
+  }
+}
+
 void Simulation::createRenderState(Application& app) {
   SingleTimeCommandBuffer commandBuffer(app);
-  this->_createRenderState(app, commandBuffer);
-  this->_solver.renderStateDirty = false;
+  this->_solver.renderStateDirty =
+      !this->_createRenderState(app, commandBuffer);
 }
 
 void Simulation::destroyRenderState(Application& app) {
   this->_vertexBuffer = {};
   this->_linesIndexBuffer = {};
   this->_trianglesIndexBuffer = {};
+  this->_lineDraws = {};
+  this->_triangleDraws = {};
+  this->_nodeDraws = {};
   this->_sphere = {};
   this->_staticGeometry = {};
 
+  // The device is idle by now, so any deferred buffers can go right away
+  this->_stagingBuffer = {};
+
   // Kinda hacky
   this->_solver.renderStateDirty = true;
 }
 
-void Simulation::_createRenderState(
+bool Simulation::_createRenderState(
     Application& app,
     VkCommandBuffer commandBuffer) {
-  this->_sphere = Sphere(app, commandBuffer);
-  this->_staticGeometry = StaticGeometry(app, commandBuffer);
+  this->_stagingBuffer = StagingBuffer(app, commandBuffer, 4 * 1024 * 1024);
 
-  std::vector<uint32_t> lineIndices = this->_solver.getLines();
+  this->_sphere = Sphere(
+      app,
+      commandBuffer,
+      this->_governor.getSettings().sphereResolution);
+  this->_staticGeometry =
+      StaticGeometry(app, commandBuffer, this->_environment);
+  this->_staticGeometryDirty = false;
+
+  return this->_createBodyBuffers(app, commandBuffer);
+}
+
+bool Simulation::_createBodyBuffers(
+    Application& app,
+    VkCommandBuffer commandBuffer) {
+  bool uploaded = true;
+  const std::vector<uint32_t>& lineIndices = this->_solver.getLines();
   if (!lineIndices.empty()) {
     this->_linesIndexBuffer =
-        IndexBuffer(app, commandBuffer, std::move(lineIndices));
+        this->_uploadIndices(app, commandBuffer, lineIndices);
+    uploaded = uploaded && this->_linesIndexBuffer.indexCount != 0;
   }
 
-  std::vector<uint32_t> triIndices = this->_solver.getTriangles();
+  const std::vector<uint32_t>& triIndices = this->_solver.getTriangles();
   if (!triIndices.empty()) {
     this->_trianglesIndexBuffer =
-        IndexBuffer(app, commandBuffer, std::move(triIndices));
+        this->_uploadIndices(app, commandBuffer, triIndices);
+    uploaded = uploaded && this->_trianglesIndexBuffer.indexCount != 0;
   }
 
   if (!this->_solver.getVertices().empty()) {
@@ -303,96 +560,294 @@ void Simulation::_createRenderState(
         commandBuffer,
         this->_solver.getVertices().size());
   }
+
+  this->_drawLists.setBodies(this->_bodies);
+  // Merged runs of visible bodies never outnumber the bodies themselves
+  uint32_t maxDrawCount = this->_drawLists.getBodyCount();
+  this->_lineDraws = IndirectDrawBuffer(app, commandBuffer, maxDrawCount);
+  this->_triangleDraws = IndirectDrawBuffer(app, commandBuffer, maxDrawCount);
+  this->_nodeDraws = IndirectDrawBuffer(app, commandBuffer, maxDrawCount);
+
+  return uploaded;
 }
 
-void Simulation::_deferredDestroyRenderState(Application& app) {
+void Simulation::_applyQualitySettings(
+    Application& app,
+    VkCommandBuffer commandBuffer) {
+  const QualitySettings& settings = this->_governor.getSettings();
+
+  this->setAdaptiveStepOptions(this->_stepOptions);
+  this->setContinuousCollisionOptions(this->_ccdOptions);
+
+  if (this->_sphere.resolution != settings.sphereResolution) {
+    // The old sphere may still be drawn by frames in flight
+    Sphere* pOldSphere = new Sphere(std::move(this->_sphere));
+    this->_stagingBuffer.getRing().deferDestroy(
+        [pOldSphere]() { delete pOldSphere; });
+
+    this->_sphere = Sphere(app, commandBuffer, settings.sphereResolution);
+  }
+}
+
+void Simulation::_deferredDestroyBodyBuffers() {
   // Move old resources to heap to prepare for deferred deletion
-  IndexBuffer* pOldLinesIndexBuffer =
-      new IndexBuffer(std::move(this->_linesIndexBuffer));
+  DeviceIndexBuffer* pOldLinesIndexBuffer =
+      new DeviceIndexBuffer(std::move(this->_linesIndexBuffer));
   this->_linesIndexBuffer = {};
-  IndexBuffer* pOldTriIndexBuffer =
-      new IndexBuffer(std::move(this->_trianglesIndexBuffer));
+  DeviceIndexBuffer* pOldTriIndexBuffer =
+      new DeviceIndexBuffer(std::move(this->_trianglesIndexBuffer));
   this->_trianglesIndexBuffer = {};
   DynamicVertexBuffer<Solver::Vertex>* pOldVertexBuffer =
       new DynamicVertexBuffer<Solver::Vertex>(std::move(this->_vertexBuffer));
   this->_vertexBuffer = {};
 
-  Sphere* pOldSphere = new Sphere(std::move(this->_sphere));
-  this->_sphere = {};
-
-  StaticGeometry* pOldStaticGeom =
-      new StaticGeometry(std::move(this->_staticGeometry));
-  this->_staticGeometry = {};
+  IndirectDrawBuffer* pOldLineDraws =
+      new IndirectDrawBuffer(std::move(this->_lineDraws));
+  IndirectDrawBuffer* pOldTriangleDraws =
+      new IndirectDrawBuffer(std::move(this->_triangleDraws));
+  IndirectDrawBuffer* pOldNodeDraws =
+      new IndirectDrawBuffer(std::move(this->_nodeDraws));
+
+  // Released along with this frame's staging allocations, once the frame
+  // has been retired
+  this->_stagingBuffer.getRing().deferDestroy([pOldLinesIndexBuffer,
+                                               pOldTriIndexBuffer,
+                                               pOldVertexBuffer,
+                                               pOldLineDraws,
+                                               pOldTriangleDraws,
+                                               pOldNodeDraws]() {
+    delete pOldLinesIndexBuffer;
+    delete pOldTriIndexBuffer;
+    delete pOldVertexBuffer;
+    delete pOldLineDraws;
+    delete pOldTriangleDraws;
+    delete pOldNodeDraws;
+  });
+}
 
-  app.addDeletiontask(
-      {[pOldLinesIndexBuffer,
-        pOldTriIndexBuffer,
-        pOldVertexBuffer,
-        pOldSphere,
-        pOldStaticGeom]() {
-         delete pOldLinesIndexBuffer;
-         delete pOldTriIndexBuffer;
-         delete pOldVertexBuffer;
-         delete pOldSphere;
-         delete pOldStaticGeom;
-       },
-       app.getCurrentFrameRingBufferIndex()});
-}
-
-Simulation::Sphere::Sphere(Application& app, VkCommandBuffer commandBuffer) {
-  constexpr uint32_t resolution = 50;
-  constexpr float maxPitch = 0.499f * glm::pi<float>();
-
-  auto sphereUvIndexToVertIndex = [resolution](uint32_t i, uint32_t j) {
-    i = i % resolution;
-    return i * resolution / 2 + j;
+Simulation::DeviceIndexBuffer Simulation::_uploadIndices(
+    Application& app,
+    VkCommandBuffer commandBuffer,
+    const std::vector<uint32_t>& indices) {
+  size_t size = indices.size() * sizeof(uint32_t);
+
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+  DeviceIndexBuffer indexBuffer{};
+  indexBuffer.indexCount = static_cast<uint32_t>(indices.size());
+  indexBuffer.allocation = BufferUtilities::createBuffer(
+      app,
+      commandBuffer,
+      size,
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      allocInfo);
+
+  auto upload = [&]() {
+    return this->_stagingBuffer.upload(
+        commandBuffer,
+        indexBuffer.allocation.getBuffer(),
+        indices.data(),
+        size,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        VK_ACCESS_INDEX_READ_BIT);
   };
 
+  if (!upload()) {
+    // Out of staging space, switch to a larger ring. The old one still has
+    // copies in flight, so it is retired through the new ring.
+    size_t capacity =
+        std::max(2 * this->_stagingBuffer.getCapacity(), 2 * size);
+    StagingBuffer* pOldStagingBuffer =
+        new StagingBuffer(std::move(this->_stagingBuffer));
+    this->_stagingBuffer = StagingBuffer(app, commandBuffer, capacity);
+    this->_stagingBuffer.getRing().deferDestroy(
+        [pOldStagingBuffer]() { delete pOldStagingBuffer; });
+
+    if (!upload()) {
+      // The buffer contents are undefined, so it must not be drawn
+      indexBuffer.indexCount = 0;
+    }
+  }
+
+  return indexBuffer;
+}
+
+size_t Simulation::_getBytesPerNode() const {
+  // Solver vertex, solver internals and stepper history on the CPU side,
+  // plus one vertex per frame in flight on the GPU side
+  return sizeof(Solver::Vertex) + this->_memoryBudget.solverBytesPerNode +
+         2 * sizeof(glm::vec3) + MAX_FRAMES_IN_FLIGHT * sizeof(Solver::Vertex);
+}
+
+size_t
+Simulation::_getFootprintBytes(const BodyTopologySizes& sizes) const {
+  return sizes.nodeCount * this->_getBytesPerNode() +
+         (sizes.lineIndexCount + sizes.triangleIndexCount) * sizeof(uint32_t);
+}
+
+size_t Simulation::_estimateSpawnBytes(const SpawnParams& params) const {
+  const BodyTopologySizes* pSizes = this->_bodies.findSizes(params);
+  if (pSizes) {
+    return this->_getFootprintBytes(*pSizes);
+  }
+
+  size_t bytes = this->_memoryBudget.unknownSpawnBytes;
+  for (uint32_t i = 0; i < this->_bodies.getSizesCount(); ++i) {
+    bytes = std::max(
+        bytes,
+        this->_getFootprintBytes(this->_bodies.getSizes(i)));
+  }
+
+  return bytes;
+}
+
+size_t Simulation::_getBudgetedBytes() const {
+  MemoryReport report = this->getMemoryReport();
+  if (this->_solver.renderStateDirty) {
+    // The body buffers are only resized in preDraw, until then the report
+    // still shows the sizes from before the latest spawns or clear
+    report.vertexBufferBytes = report.ringBufferMultiplier *
+                               this->_solver.getVertices().size() *
+                               sizeof(Solver::Vertex);
+    report.linesIndexBufferBytes =
+        this->_solver.getLines().size() * sizeof(uint32_t);
+    report.trianglesIndexBufferBytes =
+        this->_solver.getTriangles().size() * sizeof(uint32_t);
+  }
+
+  return report.getTotalBytes();
+}
+
+bool Simulation::_fitsInBudget(const SpawnParams& params) const {
+  if (this->_memoryBudget.maxBytes == 0) {
+    return true;
+  }
+
+  return this->_getBudgetedBytes() + this->_estimateSpawnBytes(params) <=
+         this->_memoryBudget.maxBytes;
+}
+
+void Simulation::_flushPendingSpawns() {
+  while (!this->_pendingSpawns.empty() &&
+         this->_fitsInBudget(this->_pendingSpawns.front().params)) {
+    this->_spawnNow(this->_pendingSpawns.front());
+    this->_pendingSpawns.pop_front();
+  }
+}
+
+void Simulation::_spawnNow(const SpawnRequest& request) {
+  uint32_t bodyId = this->_bodies.spawn(this->_solver, request);
+
+  const BodyInstance& body = this->_bodies.getBodies()[bodyId];
+  this->_ccd.seedNodes(
+      this->_solver.getVertices(),
+      body.firstNode,
+      this->_bodies.getSizes(body.sizesId).nodeCount,
+      request.initialVelocity);
+
+  this->_sceneQueryDirty = true;
+  this->_topologyChangeExported = false;
+}
+
+namespace {
+struct SphereMesh {
   std::vector<glm::vec3> vertices;
   std::vector<uint32_t> indices;
+};
+
+SphereMesh generateSphereMesh(uint32_t resolution) {
+  const float maxPitch = 0.499f * glm::pi<float>();
+  const uint32_t rows = resolution / 2;
+
+  auto sphereUvIndexToVertIndex = [resolution, rows](uint32_t i, uint32_t j) {
+    i = i % resolution;
+    return i * rows + j;
+  };
 
   // Verts from the cylinder mapping
-  uint32_t cylinderVertsCount = resolution * resolution / 2;
-  // Will include cylinder mapped verts and 2 cap verts
-  vertices.reserve(cylinderVertsCount + 2);
-  indices.reserve(3 * resolution * resolution);
-  for (uint32_t i = 0; i < resolution; ++i) {
-    float theta = i * 2.0f * glm::pi<float>() / resolution;
-    float cosTheta = cos(theta);
-    float sinTheta = sin(theta);
-
-    for (uint32_t j = 0; j < resolution / 2; ++j) {
-      float phi = j * 2.0f * maxPitch / (resolution / 2) - maxPitch;
-      float cosPhi = cos(phi);
-      float sinPhi = sin(phi);
-
-      vertices.emplace_back(cosPhi * cosTheta, sinPhi, -cosPhi * sinTheta);
-
-      if (j < resolution / 2 - 1) {
-        indices.push_back(sphereUvIndexToVertIndex(i, j));
-        indices.push_back(sphereUvIndexToVertIndex(i + 1, j));
-        indices.push_back(sphereUvIndexToVertIndex(i + 1, j + 1));
-
-        indices.push_back(sphereUvIndexToVertIndex(i, j));
-        indices.push_back(sphereUvIndexToVertIndex(i + 1, j + 1));
-        indices.push_back(sphereUvIndexToVertIndex(i, j + 1));
-      } else {
-        indices.push_back(sphereUvIndexToVertIndex(i, j));
-        indices.push_back(sphereUvIndexToVertIndex(i + 1, j));
-        indices.push_back(cylinderVertsCount);
-      }
+  uint32_t cylinderVertsCount = resolution * rows;
+
+  // Each column emits two triangles per band, one triangle into the top cap
+  // and one triangle into the bottom cap, so output sizes are known upfront
+  // and every column can be written independently.
+  uint32_t indicesPerColumn = 6 * (rows - 1) + 3 + 3;
 
-      if (j == 0) {
-        indices.push_back(sphereUvIndexToVertIndex(i, j));
-        indices.push_back(cylinderVertsCount + 1);
-        indices.push_back(sphereUvIndexToVertIndex(i + 1, j));
+  SphereMesh mesh;
+  // Will include cylinder mapped verts and 2 cap verts
+  mesh.vertices.resize(cylinderVertsCount + 2);
+  mesh.indices.resize(indicesPerColumn * resolution);
+
+  parallelFor(resolution, 8, [&](size_t begin, size_t end) {
+    for (uint32_t i = static_cast<uint32_t>(begin); i < end; ++i) {
+      float theta = i * 2.0f * glm::pi<float>() / resolution;
+      float cosTheta = cos(theta);
+      float sinTheta = sin(theta);
+
+      uint32_t* pIndex = &mesh.indices[i * indicesPerColumn];
+      for (uint32_t j = 0; j < rows; ++j) {
+        float phi = j * 2.0f * maxPitch / rows - maxPitch;
+        float cosPhi = cos(phi);
+        float sinPhi = sin(phi);
+
+        mesh.vertices[sphereUvIndexToVertIndex(i, j)] =
+            glm::vec3(cosPhi * cosTheta, sinPhi, -cosPhi * sinTheta);
+
+        if (j < rows - 1) {
+          *pIndex++ = sphereUvIndexToVertIndex(i, j);
+          *pIndex++ = sphereUvIndexToVertIndex(i + 1, j);
+          *pIndex++ = sphereUvIndexToVertIndex(i + 1, j + 1);
+
+          *pIndex++ = sphereUvIndexToVertIndex(i, j);
+          *pIndex++ = sphereUvIndexToVertIndex(i + 1, j + 1);
+          *pIndex++ = sphereUvIndexToVertIndex(i, j + 1);
+        } else {
+          *pIndex++ = sphereUvIndexToVertIndex(i, j);
+          *pIndex++ = sphereUvIndexToVertIndex(i + 1, j);
+          *pIndex++ = cylinderVertsCount;
+        }
+
+        if (j == 0) {
+          *pIndex++ = sphereUvIndexToVertIndex(i, j);
+          *pIndex++ = cylinderVertsCount + 1;
+          *pIndex++ = sphereUvIndexToVertIndex(i + 1, j);
+        }
       }
     }
-  }
+  });
 
   // Cap vertices
-  vertices.emplace_back(0.0f, 1.0f, 0.0f);
-  vertices.emplace_back(0.0f, -1.0f, 0.0f);
+  mesh.vertices[cylinderVertsCount] = glm::vec3(0.0f, 1.0f, 0.0f);
+  mesh.vertices[cylinderVertsCount + 1] = glm::vec3(0.0f, -1.0f, 0.0f);
+
+  return mesh;
+}
+
+// Sphere meshes only depend on their resolution, so they are generated once
+// and reused whenever the render state gets recreated
+const SphereMesh& getSphereMesh(uint32_t resolution) {
+  static std::mutex cacheMutex;
+  static std::unordered_map<uint32_t, SphereMesh> cache;
+
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  auto it = cache.find(resolution);
+  if (it == cache.end()) {
+    it = cache.emplace(resolution, generateSphereMesh(resolution)).first;
+  }
+
+  return it->second;
+}
+} // namespace
+
+Simulation::Sphere::Sphere(
+    Application& app,
+    VkCommandBuffer commandBuffer,
+    uint32_t resolution)
+    : resolution(resolution) {
+  const SphereMesh& mesh = getSphereMesh(resolution);
+
+  std::vector<uint32_t> indices = mesh.indices;
+  std::vector<glm::vec3> vertices = mesh.vertices;
 
   this->indexBuffer = IndexBuffer(app, commandBuffer, std::move(indices));
   this->vertexBuffer =
@@ -401,9 +856,13 @@ Simulation::Sphere::Sphere(Application& app, VkCommandBuffer commandBuffer) {
 
 Simulation::StaticGeometry::StaticGeometry(
     Application& app,
-    VkCommandBuffer commandBuffer) {
+    VkCommandBuffer commandBuffer,
+    const StaticEnvironment& environment) {
+  const std::vector<glm::vec3>& positions = environment.getPositions();
+  const std::vector<uint32_t>& indices = environment.getIndices();
+
   std::vector<Solver::Vertex> vertices;
-  vertices.resize(6);
+  vertices.resize(6 + indices.size());
 
   float height = -8.0f;
   float halfWidth = 200.0f;
@@ -416,12 +875,21 @@ Simulation::StaticGeometry::StaticGeometry(
   vertices[4].position = glm::vec3(halfWidth, height, halfWidth);
   vertices[5].position = glm::vec3(-halfWidth, height, halfWidth);
 
-  for (uint32_t i = 0; i < vertices.size(); ++i) {
+  for (uint32_t i = 0; i < 6; ++i) {
     vertices[i].baseColor = glm::vec3(1.0f, 0.0f, 0.0f);
     vertices[i].metallic = 0.0f;
     vertices[i].roughness = 0.25f;
   }
 
+  // Drawn unindexed like the floor
+  for (size_t i = 0; i < indices.size(); ++i) {
+    Solver::Vertex& vertex = vertices[6 + i];
+    vertex.position = positions[indices[i]];
+    vertex.baseColor = glm::vec3(0.5f);
+    vertex.metallic = 0.0f;
+    vertex.roughness = 0.8f;
+  }
+
   this->vertexBuffer =
       VertexBuffer<Solver::Vertex>(app, commandBuffer, std::move(vertices));
 }
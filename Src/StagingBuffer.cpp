@@ -0,0 +1,120 @@
+#include "StagingBuffer.h"
+
+#include <Althea/BufferUtilities.h>
+
+#include <cstring>
+#include <utility>
+
+namespace PiesForAlthea {
+namespace {
+// Generous enough for any buffer copy offset requirement
+constexpr size_t STAGING_ALIGNMENT = 16;
+} // namespace
+
+StagingBuffer::StagingBuffer(
+    Application& app,
+    VkCommandBuffer commandBuffer,
+    size_t capacity)
+    : _ring(capacity) {
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+  allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+  allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  this->_allocation = BufferUtilities::createBuffer(
+      app,
+      commandBuffer,
+      capacity,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      allocInfo);
+  this->_pMappedMemory = this->_allocation.mapMemory();
+}
+
+StagingBuffer::~StagingBuffer() {
+  // Anything still deferred is released along with the buffer, the owner is
+  // responsible for the device being done with it by now
+  this->_ring.retireAll();
+
+  if (this->_pMappedMemory) {
+    this->_allocation.unmapMemory();
+    this->_pMappedMemory = nullptr;
+  }
+}
+
+StagingBuffer::StagingBuffer(StagingBuffer&& rhs)
+    : _allocation(std::move(rhs._allocation)),
+      _pMappedMemory(rhs._pMappedMemory),
+      _ring(std::move(rhs._ring)) {
+  rhs._pMappedMemory = nullptr;
+  rhs._ring = {};
+}
+
+StagingBuffer& StagingBuffer::operator=(StagingBuffer&& rhs) {
+  this->_ring.retireAll();
+  if (this->_pMappedMemory) {
+    this->_allocation.unmapMemory();
+  }
+
+  this->_allocation = std::move(rhs._allocation);
+  this->_pMappedMemory = rhs._pMappedMemory;
+  this->_ring = std::move(rhs._ring);
+
+  rhs._pMappedMemory = nullptr;
+  rhs._ring = {};
+
+  return *this;
+}
+
+bool StagingBuffer::upload(
+    VkCommandBuffer commandBuffer,
+    VkBuffer dstBuffer,
+    const void* pData,
+    size_t size,
+    VkPipelineStageFlags dstStageMask,
+    VkAccessFlags dstAccessMask) {
+  StagingRing::Allocation allocation;
+  if (!this->_pMappedMemory ||
+      !this->_ring.allocate(size, STAGING_ALIGNMENT, allocation)) {
+    return false;
+  }
+
+  std::memcpy(
+      reinterpret_cast<char*>(this->_pMappedMemory) + allocation.offset,
+      pData,
+      size);
+
+  VkBufferCopy region{};
+  region.srcOffset = allocation.offset;
+  region.dstOffset = 0;
+  region.size = size;
+  vkCmdCopyBuffer(
+      commandBuffer,
+      this->_allocation.getBuffer(),
+      dstBuffer,
+      1,
+      &region);
+
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = dstAccessMask;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = dstBuffer;
+  barrier.offset = 0;
+  barrier.size = size;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      dstStageMask,
+      0,
+      0,
+      nullptr,
+      1,
+      &barrier,
+      0,
+      nullptr);
+
+  return true;
+}
+} // namespace PiesForAlthea
@@ -0,0 +1,111 @@
+#include "StagingRing.h"
+
+#include <utility>
+
+namespace PiesForAlthea {
+namespace {
+size_t alignUp(size_t offset, size_t alignment) {
+  if (alignment <= 1) {
+    return offset;
+  }
+
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+void runTasks(std::vector<std::function<void()>>& tasks) {
+  for (std::function<void()>& task : tasks) {
+    task();
+  }
+
+  tasks.clear();
+}
+} // namespace
+
+StagingRing::StagingRing(size_t capacity) : _capacity(capacity) {}
+
+bool StagingRing::allocate(
+    size_t size,
+    size_t alignment,
+    Allocation& allocation) {
+  if (size == 0 || size > this->_capacity) {
+    return false;
+  }
+
+  // Pad up to the alignment, or skip the rest of the ring if the allocation
+  // would not fit before the end
+  size_t offset = alignUp(this->_head, alignment);
+  if (offset + size > this->_capacity) {
+    offset = 0;
+  }
+
+  size_t padding = offset >= this->_head
+                       ? offset - this->_head
+                       : this->_capacity - this->_head;
+
+  // The free space is the contiguous stretch from head up to tail
+  if (padding + size > this->_capacity - this->_usedBytes) {
+    return false;
+  }
+
+  allocation.offset = offset;
+  allocation.size = size;
+
+  this->_head = (offset + size) % this->_capacity;
+  this->_usedBytes += padding + size;
+  this->_pendingBytes += padding + size;
+
+  return true;
+}
+
+void StagingRing::deferDestroy(std::function<void()>&& task) {
+  this->_pendingTasks.push_back(std::move(task));
+}
+
+void StagingRing::submit(uint64_t fenceValue) {
+  if (this->_pendingBytes == 0 && this->_pendingTasks.empty()) {
+    return;
+  }
+
+  Batch& batch = this->_batches.emplace_back();
+  batch.fenceValue = fenceValue;
+  batch.bytes = this->_pendingBytes;
+  batch.deferredTasks = std::move(this->_pendingTasks);
+
+  this->_pendingBytes = 0;
+  this->_pendingTasks.clear();
+}
+
+void StagingRing::retire(uint64_t completedFenceValue) {
+  while (!this->_batches.empty() &&
+         this->_batches.front().fenceValue <= completedFenceValue) {
+    Batch& batch = this->_batches.front();
+    runTasks(batch.deferredTasks);
+
+    this->_usedBytes -= batch.bytes;
+    if (this->_capacity > 0) {
+      this->_tail = (this->_tail + batch.bytes) % this->_capacity;
+    }
+
+    this->_batches.pop_front();
+  }
+
+  // Start from the beginning again once everything has drained, this keeps
+  // large allocations from being split by a wraparound
+  if (this->_usedBytes == 0) {
+    this->_head = 0;
+    this->_tail = 0;
+  }
+}
+
+void StagingRing::retireAll() {
+  this->submit(0);
+  while (!this->_batches.empty()) {
+    runTasks(this->_batches.front().deferredTasks);
+    this->_batches.pop_front();
+  }
+
+  this->_usedBytes = 0;
+  this->_head = 0;
+  this->_tail = 0;
+}
+} // namespace PiesForAlthea
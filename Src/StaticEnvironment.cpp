@@ -0,0 +1,338 @@
+#include "StaticEnvironment.h"
+
+#include "BinaryIO.h"
+#include "ParallelFor.h"
+#include "TriangleGeometry.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+namespace PiesForAlthea {
+namespace {
+constexpr uint32_t CACHE_MAGIC = 0x564e4550; // "PENV"
+constexpr uint32_t CACHE_VERSION = 1;
+
+const char* skipSpaces(const char* pCur, const char* pEnd) {
+  while (pCur < pEnd && (*pCur == ' ' || *pCur == '\t')) {
+    ++pCur;
+  }
+  return pCur;
+}
+
+// Trailing comments and carriage returns end a record as well
+bool isLineEnd(const char* pCur, const char* pLineEnd) {
+  return pCur >= pLineEnd || *pCur == '\r' || *pCur == '#';
+}
+
+[[noreturn]] void throwObjError(const std::string& path, size_t line) {
+  throw std::runtime_error(
+      "Malformed OBJ file " + path + " at line " + std::to_string(line));
+}
+} // namespace
+
+void StaticEnvironment::addMesh(
+    const std::vector<glm::vec3>& positions,
+    const std::vector<uint32_t>& indices,
+    const glm::mat4& transform) {
+  uint32_t baseVertex = static_cast<uint32_t>(this->_positions.size());
+  this->_positions.reserve(this->_positions.size() + positions.size());
+  for (const glm::vec3& position : positions) {
+    this->_positions.push_back(
+        glm::vec3(transform * glm::vec4(position, 1.0f)));
+  }
+
+  this->_indices.reserve(this->_indices.size() + indices.size());
+  for (uint32_t index : indices) {
+    if (index >= positions.size()) {
+      throw std::runtime_error("Static mesh index out of range.");
+    }
+    this->_indices.push_back(baseVertex + index);
+  }
+}
+
+void StaticEnvironment::addObj(
+    const std::string& path,
+    const glm::mat4& transform) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Could not open OBJ file: " + path);
+  }
+
+  std::string contents(
+      (std::istreambuf_iterator<char>(file)),
+      std::istreambuf_iterator<char>());
+
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t> indices;
+  std::vector<uint32_t> face;
+
+  // Every record is parsed within its own line, strtof and strtol would
+  // otherwise skip the newline and take numbers from the next one
+  const char* pCur = contents.data();
+  const char* pEnd = pCur + contents.size();
+  size_t line = 0;
+  while (pCur < pEnd) {
+    ++line;
+    const char* pLineEnd = static_cast<const char*>(
+        std::memchr(pCur, '\n', static_cast<size_t>(pEnd - pCur)));
+    if (pLineEnd == nullptr) {
+      pLineEnd = pEnd;
+    }
+
+    pCur = skipSpaces(pCur, pLineEnd);
+    bool isVertex = pLineEnd - pCur > 2 && pCur[0] == 'v' &&
+                    (pCur[1] == ' ' || pCur[1] == '\t');
+    bool isFace = pLineEnd - pCur > 2 && pCur[0] == 'f' &&
+                  (pCur[1] == ' ' || pCur[1] == '\t');
+    if (isVertex) {
+      pCur += 2;
+      glm::vec3 position;
+      for (int i = 0; i < 3; ++i) {
+        pCur = skipSpaces(pCur, pLineEnd);
+        if (isLineEnd(pCur, pLineEnd)) {
+          throwObjError(path, line);
+        }
+
+        char* pNext = nullptr;
+        position[i] = std::strtof(pCur, &pNext);
+        if (pNext == pCur || pNext > pLineEnd) {
+          throwObjError(path, line);
+        }
+        pCur = pNext;
+      }
+      positions.push_back(position);
+    } else if (isFace) {
+      face.clear();
+      pCur += 2;
+      while (true) {
+        pCur = skipSpaces(pCur, pLineEnd);
+        if (isLineEnd(pCur, pLineEnd)) {
+          break;
+        }
+
+        // Only the position index of "v", "v/vt", "v//vn" or "v/vt/vn"
+        char* pNext = nullptr;
+        long index = std::strtol(pCur, &pNext, 10);
+        if (pNext == pCur || pNext > pLineEnd || index == 0) {
+          throwObjError(path, line);
+        }
+
+        // Negative indices count back from the latest vertex
+        long resolved = index > 0
+                            ? index - 1
+                            : static_cast<long>(positions.size()) + index;
+        if (resolved < 0 || resolved >= static_cast<long>(positions.size())) {
+          throwObjError(path, line);
+        }
+        face.push_back(static_cast<uint32_t>(resolved));
+
+        pCur = pNext;
+        while (pCur < pLineEnd && *pCur != ' ' && *pCur != '\t' &&
+               *pCur != '\r') {
+          ++pCur;
+        }
+      }
+
+      if (face.size() < 3) {
+        throwObjError(path, line);
+      }
+
+      for (size_t i = 1; i + 1 < face.size(); ++i) {
+        indices.push_back(face[0]);
+        indices.push_back(face[i]);
+        indices.push_back(face[i + 1]);
+      }
+    }
+
+    pCur = pLineEnd < pEnd ? pLineEnd + 1 : pEnd;
+  }
+
+  this->addMesh(positions, indices, transform);
+}
+
+void StaticEnvironment::addHeightfield(
+    const std::vector<float>& heights,
+    uint32_t width,
+    uint32_t depth,
+    const glm::vec3& origin,
+    float spacing) {
+  if (width < 2 || depth < 2 ||
+      heights.size() != static_cast<size_t>(width) * depth) {
+    throw std::runtime_error("Heightfield size does not match its samples.");
+  }
+
+  std::vector<glm::vec3> positions(heights.size());
+  for (uint32_t z = 0; z < depth; ++z) {
+    for (uint32_t x = 0; x < width; ++x) {
+      positions[z * width + x] =
+          origin +
+          glm::vec3(x * spacing, heights[z * width + x], z * spacing);
+    }
+  }
+
+  std::vector<uint32_t> indices;
+  indices.reserve(6 * (width - 1) * (depth - 1));
+  for (uint32_t z = 0; z + 1 < depth; ++z) {
+    for (uint32_t x = 0; x + 1 < width; ++x) {
+      uint32_t i00 = z * width + x;
+      uint32_t i10 = i00 + 1;
+      uint32_t i01 = i00 + width;
+      uint32_t i11 = i01 + 1;
+
+      // Wound so that the normals face up
+      indices.push_back(i00);
+      indices.push_back(i01);
+      indices.push_back(i10);
+
+      indices.push_back(i10);
+      indices.push_back(i01);
+      indices.push_back(i11);
+    }
+  }
+
+  this->addMesh(positions, indices);
+}
+
+void StaticEnvironment::build() {
+  size_t triangleCount = this->getTriangleCount();
+  std::vector<Aabb> bounds(triangleCount);
+  parallelFor(triangleCount, 4096, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      bounds[i].expand(this->_positions[this->_indices[3 * i + 0]]);
+      bounds[i].expand(this->_positions[this->_indices[3 * i + 1]]);
+      bounds[i].expand(this->_positions[this->_indices[3 * i + 2]]);
+    }
+  });
+
+  this->_bvh.build(bounds);
+}
+
+void StaticEnvironment::clear() {
+  this->_positions.clear();
+  this->_indices.clear();
+  this->_bvh.clear();
+}
+
+/*static*/
+StaticEnvironment StaticEnvironment::loadObjCached(
+    const std::string& objPath,
+    const std::string& cachePath,
+    const glm::mat4& transform) {
+  std::error_code sizeError;
+  std::error_code timeError;
+  uintmax_t fileSize = std::filesystem::file_size(objPath, sizeError);
+  auto writeTime = std::filesystem::last_write_time(objPath, timeError);
+  bool error = sizeError || timeError;
+
+  // Exact float formatting, so any change to the transform misses the cache
+  std::ostringstream key;
+  key << std::hexfloat << objPath << "|" << fileSize << "|"
+      << writeTime.time_since_epoch().count();
+  for (int i = 0; i < 4; ++i) {
+    key << "|" << transform[i].x << "," << transform[i].y << ","
+        << transform[i].z << "," << transform[i].w;
+  }
+
+  StaticEnvironment environment;
+  if (!error && environment.readCache(cachePath, key.str())) {
+    return environment;
+  }
+
+  environment.addObj(objPath, transform);
+  environment.build();
+
+  if (!error) {
+    environment.writeCache(cachePath, key.str());
+  }
+
+  return environment;
+}
+
+void StaticEnvironment::writeCache(
+    const std::string& path,
+    const std::string& key) const {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    // Caching is only an optimization
+    return;
+  }
+
+  writeValue(file, CACHE_MAGIC);
+  writeValue(file, CACHE_VERSION);
+  writeString(file, key);
+  writeVector(file, this->_positions);
+  writeVector(file, this->_indices);
+  this->_bvh.write(file);
+}
+
+bool StaticEnvironment::readCache(
+    const std::string& path,
+    const std::string& key) {
+  this->clear();
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  std::string cachedKey;
+  if (!readValue(file, magic) || magic != CACHE_MAGIC ||
+      !readValue(file, version) || version != CACHE_VERSION ||
+      !readString(file, cachedKey) || cachedKey != key ||
+      !readVector(file, this->_positions) ||
+      !readVector(file, this->_indices) || !this->_bvh.read(file)) {
+    this->clear();
+    return false;
+  }
+
+  bool valid = this->_indices.size() % 3 == 0 &&
+               this->_bvh.getPrimitiveCount() == this->getTriangleCount();
+  for (uint32_t index : this->_indices) {
+    valid = valid && index < this->_positions.size();
+  }
+
+  if (!valid) {
+    this->clear();
+    return false;
+  }
+
+  return true;
+}
+
+float StaticEnvironment::raycast(
+    const glm::vec3& origin,
+    const glm::vec3& direction,
+    float maxDistance,
+    uint32_t& triangle) const {
+  return this->_bvh.raycast(
+      origin,
+      direction,
+      maxDistance,
+      [&](uint32_t primitive, float closest) {
+        float t = intersectRayTriangle(
+            origin,
+            direction,
+            this->_positions[this->_indices[3 * primitive]],
+            this->_positions[this->_indices[3 * primitive + 1]],
+            this->_positions[this->_indices[3 * primitive + 2]],
+            closest);
+        if (t < closest) {
+          triangle = primitive;
+        }
+
+        return t;
+      });
+}
+
+size_t StaticEnvironment::getBytes() const {
+  return this->_positions.capacity() * sizeof(glm::vec3) +
+         this->_indices.capacity() * sizeof(uint32_t) + this->_bvh.getBytes();
+}
+} // namespace PiesForAlthea
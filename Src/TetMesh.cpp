@@ -0,0 +1,920 @@
+#include "TetMesh.h"
+
+#include "BinaryIO.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace PiesForAlthea {
+namespace {
+constexpr uint32_t CACHE_MAGIC = 0x54455450; // "PTET"
+constexpr uint32_t CACHE_VERSION = 1;
+
+// Bytes of TetGen records each thread parses at least
+constexpr size_t PARSE_CHUNK_SIZE = 1 << 20;
+
+// Node tags in MSH files are looked up through a table, so they can't
+// leave too many gaps
+constexpr uint64_t MAX_TAG_SPARSITY = 8;
+
+constexpr uint32_t INVALID_INDEX = ~0u;
+
+[[noreturn]] void throwTetMeshError(const std::string& path) {
+  throw std::runtime_error("Malformed tet mesh file " + path);
+}
+
+// Read-only view of a whole file, memory mapped where available
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Could not open tet mesh file: " + path);
+    }
+
+    this->_contents.assign(
+        (std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    this->_pData = this->_contents.data();
+    this->_size = this->_contents.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Could not open tet mesh file: " + path);
+    }
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Could not open tet mesh file: " + path);
+    }
+
+    this->_size = static_cast<size_t>(info.st_size);
+    if (this->_size > 0) {
+      void* pData = mmap(nullptr, this->_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (pData == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Could not map tet mesh file: " + path);
+      }
+
+      this->_pData = static_cast<const char*>(pData);
+    }
+    ::close(fd);
+#endif
+  }
+
+  ~MappedFile() {
+#ifndef _WIN32
+    if (this->_pData) {
+      munmap(const_cast<char*>(this->_pData), this->_size);
+    }
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* begin() const { return this->_pData; }
+  const char* end() const { return this->_pData + this->_size; }
+
+private:
+  const char* _pData = nullptr;
+  size_t _size = 0;
+#ifdef _WIN32
+  std::string _contents;
+#endif
+};
+
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Reads numbers straight out of the mapped file, without copying or
+// allocating. Reads stay on the current line, except for readNext.
+struct Tokenizer {
+  const char* pCur;
+  const char* pEnd;
+
+  void skipSpaces() {
+    while (this->pCur < this->pEnd && isSpace(*this->pCur)) {
+      ++this->pCur;
+    }
+  }
+
+  // Also treats comments as the end of the line
+  bool atLineEnd() {
+    this->skipSpaces();
+    return this->pCur >= this->pEnd || *this->pCur == '\n' ||
+           *this->pCur == '#';
+  }
+
+  void nextLine() {
+    const char* pNewline = static_cast<const char*>(
+        std::memchr(this->pCur, '\n', this->pEnd - this->pCur));
+    this->pCur = pNewline ? pNewline + 1 : this->pEnd;
+  }
+
+  // Moves to the start of the next line with something other than a
+  // comment on it
+  bool nextRecord() {
+    while (this->pCur < this->pEnd && this->atLineEnd()) {
+      this->nextLine();
+    }
+    return this->pCur < this->pEnd;
+  }
+
+  bool startsWith(const char* token) const {
+    size_t length = std::strlen(token);
+    return static_cast<size_t>(this->pEnd - this->pCur) >= length &&
+           std::memcmp(this->pCur, token, length) == 0 &&
+           (this->pCur + length == this->pEnd ||
+            isSpace(this->pCur[length]) || this->pCur[length] == '\n');
+  }
+
+  template <typename T> bool read(T& value) {
+    this->skipSpaces();
+    // from_chars doesn't take an explicit plus sign
+    if (this->pCur < this->pEnd && *this->pCur == '+') {
+      ++this->pCur;
+    }
+
+    auto [pNext, error] = std::from_chars(this->pCur, this->pEnd, value);
+    if (error != std::errc() ||
+        (pNext < this->pEnd && !isSpace(*pNext) && *pNext != '\n' &&
+         *pNext != '#')) {
+      return false;
+    }
+
+    this->pCur = pNext;
+    return true;
+  }
+
+  // For the MSH sections, which don't care where the lines break
+  template <typename T> bool readNext(T& value) {
+    while (this->pCur < this->pEnd &&
+           (isSpace(*this->pCur) || *this->pCur == '\n')) {
+      ++this->pCur;
+    }
+    return this->read(value);
+  }
+};
+
+bool readNodeIndex(
+    Tokenizer& tokenizer,
+    int64_t firstIndex,
+    size_t nodeCount,
+    uint32_t& node) {
+  int64_t index = 0;
+  if (!tokenizer.read(index)) {
+    return false;
+  }
+
+  index -= firstIndex;
+  if (index < 0 || static_cast<uint64_t>(index) >= nodeCount) {
+    return false;
+  }
+
+  node = static_cast<uint32_t>(index);
+  return true;
+}
+
+// Parses the records between pBegin and pEnd in parallel chunks, every line
+// that isn't blank or a comment is one record. TetGen records start with
+// their own index, so each can be stored independently of the others by
+// parseRecord(tokenizer, record). Throws unless every record index up to
+// recordCount shows up exactly once.
+template <typename TFn>
+void parseRecords(
+    const char* pBegin,
+    const char* pEnd,
+    const std::string& path,
+    int64_t firstIndex,
+    size_t recordCount,
+    TFn&& parseRecord) {
+  std::vector<std::atomic<bool>> written(recordCount);
+  std::atomic<size_t> parsedCount = 0;
+  std::atomic<bool> failed = false;
+  parallelFor(pEnd - pBegin, PARSE_CHUNK_SIZE, [&](size_t begin, size_t end) {
+    // Each chunk takes the lines that start inside it
+    Tokenizer tokenizer{pBegin + begin, pEnd};
+    if (begin > 0 && pBegin[begin - 1] != '\n') {
+      tokenizer.nextLine();
+    }
+
+    const char* pStop = pBegin + end;
+    size_t localCount = 0;
+    while (tokenizer.pCur < pStop) {
+      if (!tokenizer.atLineEnd()) {
+        uint32_t record = 0;
+        if (!readNodeIndex(tokenizer, firstIndex, recordCount, record) ||
+            written[record].exchange(true, std::memory_order_relaxed) ||
+            !parseRecord(tokenizer, record)) {
+          failed = true;
+          return;
+        }
+        ++localCount;
+      }
+      tokenizer.nextLine();
+    }
+
+    parsedCount += localCount;
+  });
+
+  // No index was repeated, so the right count means none is missing
+  if (failed || parsedCount != recordCount) {
+    throwTetMeshError(path);
+  }
+}
+
+// Reads the header line of a TetGen file and finds out whether its records
+// are numbered from zero or one. Returns where the records start.
+template <size_t N>
+const char* readTetGenHeader(
+    const MappedFile& file,
+    const std::string& path,
+    std::array<uint64_t, N>& header,
+    int64_t& firstIndex) {
+  Tokenizer tokenizer{file.begin(), file.end()};
+  if (!tokenizer.nextRecord()) {
+    throwTetMeshError(path);
+  }
+
+  for (uint64_t& value : header) {
+    if (!tokenizer.read(value)) {
+      throwTetMeshError(path);
+    }
+  }
+
+  tokenizer.nextLine();
+  const char* pRecords = tokenizer.pCur;
+
+  firstIndex = 0;
+  if (header[0] > 0 &&
+      (!tokenizer.nextRecord() || !tokenizer.read(firstIndex))) {
+    throwTetMeshError(path);
+  }
+
+  if (header[0] >= INVALID_INDEX) {
+    throwTetMeshError(path);
+  }
+
+  return pRecords;
+}
+
+std::string getTetGenBase(const std::string& path) {
+  std::filesystem::path base(path);
+  std::string extension = base.extension().string();
+  if (extension == ".node" || extension == ".ele" || extension == ".face") {
+    base.replace_extension();
+  }
+
+  return base.string();
+}
+
+bool isMshTetType(uint32_t type) {
+  // Linear and quadratic tets, only the corners of the latter are kept
+  return type == 4 || type == 11;
+}
+
+uint32_t lookUpMshNode(
+    const std::vector<uint32_t>& nodeIndices,
+    uint64_t tag,
+    const std::string& path) {
+  if (tag >= nodeIndices.size() || nodeIndices[tag] == INVALID_INDEX) {
+    throwTetMeshError(path);
+  }
+
+  return nodeIndices[tag];
+}
+
+void growMshTagTable(
+    std::vector<uint32_t>& nodeIndices,
+    uint64_t maxTag,
+    uint64_t nodeCount,
+    const std::string& path) {
+  if (maxTag > MAX_TAG_SPARSITY * nodeCount + 1024) {
+    throw std::runtime_error("MSH node tags are too sparse in " + path);
+  }
+
+  if (nodeIndices.size() <= maxTag) {
+    nodeIndices.resize(maxTag + 1, INVALID_INDEX);
+  }
+}
+
+// Counting sort on the node the values are keyed by first, which leaves
+// buckets small enough to finish sorting in parallel. Much faster than one
+// big comparison sort over the millions of edges and faces of a large mesh.
+template <typename T, typename TGetNode, typename TLess>
+void sortByNode(
+    std::vector<T>& values,
+    size_t nodeCount,
+    TGetNode&& getNode,
+    TLess&& less) {
+  std::vector<size_t> offsets(nodeCount + 1, 0);
+  for (const T& value : values) {
+    ++offsets[getNode(value) + 1];
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  std::vector<T> sorted(values.size());
+  std::vector<size_t> cursors(offsets.begin(), offsets.end() - 1);
+  for (const T& value : values) {
+    sorted[cursors[getNode(value)]++] = value;
+  }
+
+  parallelFor(nodeCount, 4096, [&](size_t begin, size_t end) {
+    for (size_t node = begin; node < end; ++node) {
+      std::sort(
+          sorted.begin() + offsets[node],
+          sorted.begin() + offsets[node + 1],
+          less);
+    }
+  });
+
+  values = std::move(sorted);
+}
+
+struct TetFace {
+  // Sorted, to find the faces shared by two tets
+  std::array<uint32_t, 3> nodes;
+  uint32_t opposite;
+};
+} // namespace
+
+/*static*/
+TetMesh TetMesh::loadTetGen(const std::string& path) {
+  TetMesh mesh;
+  std::string base = getTetGenBase(path);
+
+  // Node references in the other files use the numbering of the .node file
+  int64_t firstNode = 0;
+  {
+    std::string nodePath = base + ".node";
+    MappedFile file(nodePath);
+
+    // <# of points> <dimension> <# of attributes> <boundary markers>
+    std::array<uint64_t, 2> header{};
+    const char* pRecords = readTetGenHeader(file, nodePath, header, firstNode);
+    if (header[1] != 3) {
+      throwTetMeshError(nodePath);
+    }
+
+    mesh._positions.resize(header[0]);
+    parseRecords(
+        pRecords,
+        file.end(),
+        nodePath,
+        firstNode,
+        header[0],
+        [&](Tokenizer& tokenizer, uint32_t node) {
+          glm::vec3 position;
+          if (!tokenizer.read(position.x) || !tokenizer.read(position.y) ||
+              !tokenizer.read(position.z)) {
+            return false;
+          }
+
+          mesh._positions[node] = position;
+          return true;
+        });
+  }
+
+  {
+    std::string elePath = base + ".ele";
+    MappedFile file(elePath);
+
+    // <# of tets> <nodes per tet> <region attribute>
+    std::array<uint64_t, 2> header{};
+    int64_t firstIndex = 0;
+    const char* pRecords = readTetGenHeader(file, elePath, header, firstIndex);
+    if (header[1] != 4 && header[1] != 10) {
+      throwTetMeshError(elePath);
+    }
+
+    size_t nodeCount = mesh._positions.size();
+    mesh._tets.resize(4 * header[0]);
+    parseRecords(
+        pRecords,
+        file.end(),
+        elePath,
+        firstIndex,
+        header[0],
+        [&](Tokenizer& tokenizer, uint32_t tet) {
+          // Quadratic tets list their corners first
+          for (uint32_t i = 0; i < 4; ++i) {
+            if (!readNodeIndex(
+                    tokenizer,
+                    firstNode,
+                    nodeCount,
+                    mesh._tets[4 * tet + i])) {
+              return false;
+            }
+          }
+
+          return true;
+        });
+  }
+
+  std::string facePath = base + ".face";
+  bool hasFaces = std::filesystem::exists(facePath);
+  if (hasFaces) {
+    MappedFile file(facePath);
+
+    // <# of faces> <boundary markers>
+    std::array<uint64_t, 1> header{};
+    int64_t firstIndex = 0;
+    const char* pRecords =
+        readTetGenHeader(file, facePath, header, firstIndex);
+
+    size_t nodeCount = mesh._positions.size();
+    mesh._triangles.resize(3 * header[0]);
+    parseRecords(
+        pRecords,
+        file.end(),
+        facePath,
+        firstIndex,
+        header[0],
+        [&](Tokenizer& tokenizer, uint32_t face) {
+          for (uint32_t i = 0; i < 3; ++i) {
+            if (!readNodeIndex(
+                    tokenizer,
+                    firstNode,
+                    nodeCount,
+                    mesh._triangles[3 * face + i])) {
+              return false;
+            }
+          }
+
+          return true;
+        });
+  }
+
+  mesh._buildTopology(hasFaces);
+  return mesh;
+}
+
+/*static*/
+TetMesh TetMesh::loadMsh(const std::string& path) {
+  TetMesh mesh;
+  MappedFile file(path);
+  Tokenizer tokenizer{file.begin(), file.end()};
+
+  double version = 0.0;
+  // Maps node tags to node indices
+  std::vector<uint32_t> nodeIndices;
+
+  auto readNode = [&]() {
+    glm::vec3 position;
+    if (!tokenizer.readNext(position.x) || !tokenizer.readNext(position.y) ||
+        !tokenizer.readNext(position.z)) {
+      throwTetMeshError(path);
+    }
+
+    mesh._positions.push_back(position);
+    // Parametric coordinates may follow
+    tokenizer.nextLine();
+  };
+
+  auto readTet = [&]() {
+    for (uint32_t i = 0; i < 4; ++i) {
+      uint64_t tag = 0;
+      if (!tokenizer.readNext(tag)) {
+        throwTetMeshError(path);
+      }
+      mesh._tets.push_back(lookUpMshNode(nodeIndices, tag, path));
+    }
+  };
+
+  while (tokenizer.pCur < tokenizer.pEnd) {
+    tokenizer.skipSpaces();
+
+    if (tokenizer.startsWith("$MeshFormat")) {
+      tokenizer.nextLine();
+      uint32_t fileType = 0;
+      if (!tokenizer.readNext(version) || !tokenizer.readNext(fileType)) {
+        throwTetMeshError(path);
+      }
+
+      if (fileType != 0) {
+        throw std::runtime_error("Binary MSH files are not supported: " + path);
+      }
+
+      if (version < 2.0 || version >= 5.0 ||
+          (version >= 3.0 && version < 4.1)) {
+        throw std::runtime_error(
+            "Only MSH versions 2 and 4.1 are supported: " + path);
+      }
+    } else if (tokenizer.startsWith("$Nodes")) {
+      tokenizer.nextLine();
+      if (version == 0.0) {
+        throwTetMeshError(path);
+      }
+
+      if (version < 3.0) {
+        // <# of nodes>, then <tag> <x> <y> <z> per node
+        uint64_t nodeCount = 0;
+        if (!tokenizer.readNext(nodeCount) || nodeCount >= INVALID_INDEX) {
+          throwTetMeshError(path);
+        }
+
+        mesh._positions.reserve(nodeCount);
+        for (uint64_t i = 0; i < nodeCount; ++i) {
+          uint64_t tag = 0;
+          if (!tokenizer.readNext(tag)) {
+            throwTetMeshError(path);
+          }
+
+          growMshTagTable(nodeIndices, tag, nodeCount, path);
+          if (nodeIndices[tag] != INVALID_INDEX) {
+            throwTetMeshError(path);
+          }
+          nodeIndices[tag] = static_cast<uint32_t>(mesh._positions.size());
+          readNode();
+        }
+      } else {
+        // Blocks of node tags followed by the coordinates of those nodes
+        uint64_t blockCount = 0;
+        uint64_t nodeCount = 0;
+        uint64_t minTag = 0;
+        uint64_t maxTag = 0;
+        if (!tokenizer.readNext(blockCount) ||
+            !tokenizer.readNext(nodeCount) || !tokenizer.readNext(minTag) ||
+            !tokenizer.readNext(maxTag) || nodeCount >= INVALID_INDEX) {
+          throwTetMeshError(path);
+        }
+
+        growMshTagTable(nodeIndices, maxTag, nodeCount, path);
+        mesh._positions.reserve(nodeCount);
+        for (uint64_t block = 0; block < blockCount; ++block) {
+          uint32_t entityDim = 0;
+          uint32_t entityTag = 0;
+          uint32_t parametric = 0;
+          uint64_t blockNodeCount = 0;
+          if (!tokenizer.readNext(entityDim) ||
+              !tokenizer.readNext(entityTag) ||
+              !tokenizer.readNext(parametric) ||
+              !tokenizer.readNext(blockNodeCount) ||
+              mesh._positions.size() + blockNodeCount > nodeCount) {
+            throwTetMeshError(path);
+          }
+
+          uint32_t firstNode = static_cast<uint32_t>(mesh._positions.size());
+          for (uint64_t i = 0; i < blockNodeCount; ++i) {
+            uint64_t tag = 0;
+            if (!tokenizer.readNext(tag) || tag > maxTag ||
+                nodeIndices[tag] != INVALID_INDEX) {
+              throwTetMeshError(path);
+            }
+            nodeIndices[tag] = firstNode + static_cast<uint32_t>(i);
+          }
+
+          for (uint64_t i = 0; i < blockNodeCount; ++i) {
+            readNode();
+          }
+        }
+      }
+    } else if (tokenizer.startsWith("$Elements")) {
+      tokenizer.nextLine();
+      if (version == 0.0) {
+        throwTetMeshError(path);
+      }
+
+      if (version < 3.0) {
+        // <# of elements>, then
+        // <tag> <type> <# of tags> <tags...> <nodes...> per element
+        uint64_t elementCount = 0;
+        if (!tokenizer.readNext(elementCount)) {
+          throwTetMeshError(path);
+        }
+
+        for (uint64_t i = 0; i < elementCount; ++i) {
+          uint64_t tag = 0;
+          uint32_t type = 0;
+          uint32_t tagCount = 0;
+          if (!tokenizer.readNext(tag) || !tokenizer.readNext(type) ||
+              !tokenizer.readNext(tagCount)) {
+            throwTetMeshError(path);
+          }
+
+          if (isMshTetType(type)) {
+            for (uint32_t j = 0; j < tagCount; ++j) {
+              int64_t elementTag = 0;
+              if (!tokenizer.readNext(elementTag)) {
+                throwTetMeshError(path);
+              }
+            }
+
+            readTet();
+          }
+
+          tokenizer.nextLine();
+        }
+      } else {
+        // Blocks of elements of one type, <tag> <nodes...> per element
+        uint64_t blockCount = 0;
+        uint64_t elementCount = 0;
+        uint64_t minTag = 0;
+        uint64_t maxTag = 0;
+        if (!tokenizer.readNext(blockCount) ||
+            !tokenizer.readNext(elementCount) ||
+            !tokenizer.readNext(minTag) || !tokenizer.readNext(maxTag)) {
+          throwTetMeshError(path);
+        }
+
+        for (uint64_t block = 0; block < blockCount; ++block) {
+          uint32_t entityDim = 0;
+          uint32_t entityTag = 0;
+          uint32_t type = 0;
+          uint64_t blockElementCount = 0;
+          if (!tokenizer.readNext(entityDim) ||
+              !tokenizer.readNext(entityTag) || !tokenizer.readNext(type) ||
+              !tokenizer.readNext(blockElementCount) ||
+              blockElementCount > elementCount) {
+            throwTetMeshError(path);
+          }
+          tokenizer.nextLine();
+
+          bool isTet = isMshTetType(type);
+          if (isTet) {
+            mesh._tets.reserve(mesh._tets.size() + 4 * blockElementCount);
+          }
+
+          for (uint64_t i = 0; i < blockElementCount; ++i) {
+            uint64_t tag = 0;
+            if (isTet) {
+              if (!tokenizer.readNext(tag)) {
+                throwTetMeshError(path);
+              }
+              readTet();
+            }
+            tokenizer.nextLine();
+          }
+        }
+      }
+    }
+
+    tokenizer.nextLine();
+  }
+
+  mesh._buildTopology(false);
+  return mesh;
+}
+
+/*static*/
+TetMesh
+TetMesh::loadCached(const std::string& path, const std::string& cachePath) {
+  bool isMsh = std::filesystem::path(path).extension() == ".msh";
+  std::string base = isMsh ? path : getTetGenBase(path);
+  std::vector<std::string> sources;
+  if (isMsh) {
+    sources.push_back(path);
+  } else {
+    sources.push_back(base + ".node");
+    sources.push_back(base + ".ele");
+  }
+
+  bool error = false;
+  std::ostringstream key;
+  for (const std::string& source : sources) {
+    std::error_code sizeError;
+    std::error_code timeError;
+    uintmax_t fileSize = std::filesystem::file_size(source, sizeError);
+    auto writeTime = std::filesystem::last_write_time(source, timeError);
+    error = error || sizeError || timeError;
+    key << source << "|" << fileSize << "|"
+        << writeTime.time_since_epoch().count() << "|";
+  }
+
+  // The .face file is optional, but adding or removing it changes the mesh
+  if (!isMsh) {
+    std::string facePath = base + ".face";
+    std::error_code sizeError;
+    std::error_code timeError;
+    if (std::filesystem::exists(facePath)) {
+      uintmax_t fileSize = std::filesystem::file_size(facePath, sizeError);
+      auto writeTime = std::filesystem::last_write_time(facePath, timeError);
+      error = error || sizeError || timeError;
+      key << facePath << "|" << fileSize << "|"
+          << writeTime.time_since_epoch().count();
+    }
+  }
+
+  std::string cacheFile = cachePath.empty() ? base + ".tetcache" : cachePath;
+
+  TetMesh mesh;
+  if (!error && mesh.readCache(cacheFile, key.str())) {
+    return mesh;
+  }
+
+  mesh = isMsh ? loadMsh(path) : loadTetGen(path);
+
+  if (!error) {
+    mesh.writeCache(cacheFile, key.str());
+  }
+
+  return mesh;
+}
+
+void TetMesh::writeCache(const std::string& path, const std::string& key)
+    const {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    // Caching is only an optimization
+    return;
+  }
+
+  writeValue(file, CACHE_MAGIC);
+  writeValue(file, CACHE_VERSION);
+  writeString(file, key);
+  writeVector(file, this->_positions);
+  writeVector(file, this->_tets);
+  writeVector(file, this->_lines);
+  writeVector(file, this->_triangles);
+}
+
+bool TetMesh::readCache(const std::string& path, const std::string& key) {
+  *this = {};
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  std::string cachedKey;
+  if (!readValue(file, magic) || magic != CACHE_MAGIC ||
+      !readValue(file, version) || version != CACHE_VERSION ||
+      !readString(file, cachedKey) || cachedKey != key ||
+      !readVector(file, this->_positions) || !readVector(file, this->_tets) ||
+      !readVector(file, this->_lines) ||
+      !readVector(file, this->_triangles)) {
+    *this = {};
+    return false;
+  }
+
+  bool valid = this->_tets.size() % 4 == 0 && this->_lines.size() % 2 == 0 &&
+               this->_triangles.size() % 3 == 0;
+  size_t nodeCount = this->_positions.size();
+  for (const std::vector<uint32_t>* pIndices :
+       {&this->_tets, &this->_lines, &this->_triangles}) {
+    for (uint32_t index : *pIndices) {
+      valid = valid && index < nodeCount;
+    }
+  }
+
+  if (!valid) {
+    *this = {};
+    return false;
+  }
+
+  return true;
+}
+
+size_t TetMesh::getBytes() const {
+  return this->_positions.capacity() * sizeof(glm::vec3) +
+         (this->_tets.capacity() + this->_lines.capacity() +
+          this->_triangles.capacity()) *
+             sizeof(uint32_t);
+}
+
+void TetMesh::_buildTopology(bool hasTriangles) {
+  if (this->_tets.empty()) {
+    throw std::runtime_error("Tet mesh contains no tetrahedra.");
+  }
+
+  size_t tetCount = this->getTetCount();
+
+  // Every edge is shared by several tets, sorting brings the copies
+  // together
+  constexpr uint32_t tetEdges[6][2] =
+      {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}};
+  std::vector<uint64_t> edges(6 * tetCount);
+  parallelFor(tetCount, 4096, [&](size_t begin, size_t end) {
+    for (size_t tet = begin; tet < end; ++tet) {
+      const uint32_t* pTet = &this->_tets[4 * tet];
+      for (uint32_t i = 0; i < 6; ++i) {
+        uint32_t a = pTet[tetEdges[i][0]];
+        uint32_t b = pTet[tetEdges[i][1]];
+        edges[6 * tet + i] = (static_cast<uint64_t>(std::min(a, b)) << 32) |
+                             std::max(a, b);
+      }
+    }
+  });
+  sortByNode(
+      edges,
+      this->_positions.size(),
+      [](uint64_t edge) { return static_cast<uint32_t>(edge >> 32); },
+      std::less<uint64_t>());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  this->_lines.clear();
+  this->_lines.reserve(2 * edges.size());
+  for (uint64_t edge : edges) {
+    this->_lines.push_back(static_cast<uint32_t>(edge >> 32));
+    this->_lines.push_back(static_cast<uint32_t>(edge));
+  }
+
+  // Faces only used by one tet are on the boundary, the tet's remaining
+  // node tells which way is outside
+  constexpr uint32_t tetFaces[4][4] =
+      {{1, 2, 3, 0}, {0, 2, 3, 1}, {0, 1, 3, 2}, {0, 1, 2, 3}};
+  std::vector<TetFace> faces(4 * tetCount);
+  parallelFor(tetCount, 4096, [&](size_t begin, size_t end) {
+    for (size_t tet = begin; tet < end; ++tet) {
+      const uint32_t* pTet = &this->_tets[4 * tet];
+      for (uint32_t i = 0; i < 4; ++i) {
+        TetFace& face = faces[4 * tet + i];
+        face.nodes = {
+            pTet[tetFaces[i][0]],
+            pTet[tetFaces[i][1]],
+            pTet[tetFaces[i][2]]};
+        std::sort(face.nodes.begin(), face.nodes.end());
+        face.opposite = pTet[tetFaces[i][3]];
+      }
+    }
+  });
+  sortByNode(
+      faces,
+      this->_positions.size(),
+      [](const TetFace& face) { return face.nodes[0]; },
+      [](const TetFace& a, const TetFace& b) { return a.nodes < b.nodes; });
+
+  auto isBoundary = [&](size_t i) {
+    return (i == 0 || faces[i - 1].nodes != faces[i].nodes) &&
+           (i + 1 == faces.size() || faces[i + 1].nodes != faces[i].nodes);
+  };
+
+  std::vector<uint32_t> triangles;
+  auto addOutward = [&](uint32_t a, uint32_t b, uint32_t c, uint32_t opposite) {
+    const glm::vec3& pa = this->_positions[a];
+    glm::vec3 normal =
+        glm::cross(this->_positions[b] - pa, this->_positions[c] - pa);
+    if (glm::dot(normal, this->_positions[opposite] - pa) > 0.0f) {
+      std::swap(b, c);
+    }
+
+    triangles.push_back(a);
+    triangles.push_back(b);
+    triangles.push_back(c);
+  };
+
+  if (hasTriangles) {
+    // Keep the given faces that are on the boundary, which drops the
+    // interior faces TetGen writes with -f
+    for (size_t i = 0; i < this->_triangles.size(); i += 3) {
+      TetFace key{};
+      key.nodes = {
+          this->_triangles[i],
+          this->_triangles[i + 1],
+          this->_triangles[i + 2]};
+      std::sort(key.nodes.begin(), key.nodes.end());
+      auto it = std::lower_bound(
+          faces.begin(),
+          faces.end(),
+          key,
+          [](const TetFace& a, const TetFace& b) { return a.nodes < b.nodes; });
+      if (it == faces.end() || it->nodes != key.nodes) {
+        throw std::runtime_error("Tet mesh face is not part of any tet.");
+      }
+
+      if (isBoundary(it - faces.begin())) {
+        addOutward(
+            this->_triangles[i],
+            this->_triangles[i + 1],
+            this->_triangles[i + 2],
+            it->opposite);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < faces.size(); ++i) {
+      if (isBoundary(i)) {
+        addOutward(
+            faces[i].nodes[0],
+            faces[i].nodes[1],
+            faces[i].nodes[2],
+            faces[i].opposite);
+      }
+    }
+  }
+
+  this->_triangles = std::move(triangles);
+}
+} // namespace PiesForAlthea
@@ -1,13 +1,41 @@
 #include "DemoScene.h"
+#include "EnsembleRunner.h"
 
 #include <Althea/Application.h>
 
+#include <cstring>
 #include <iostream>
 
 using namespace PiesForAlthea;
 using namespace AltheaEngine;
 
-int main() {
+int main(int argc, char** argv) {
+  // Headless parameter sweep, does not create a window or a device
+  if (argc > 1 && std::strcmp(argv[1], "--ensemble") == 0) {
+    try {
+      EnsembleRunner runner(EnsembleRunner::parseArgs(argc, argv, 2));
+      for (const EnsembleRunResult& result : runner.run()) {
+        if (!result.error.empty()) {
+          std::cerr << "Run with stiffness " << result.stiffness
+                    << ", grid spacing " << result.gridSpacing
+                    << " and launch speed " << result.launchSpeed
+                    << " failed: " << result.error << std::endl;
+        }
+      }
+
+      // Failed runs are still written out, along with their errors
+      runner.writeResults();
+      if (runner.getFailedRunCount() != 0) {
+        return EXIT_FAILURE;
+      }
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+  }
+
   Application app("../..", "../../Extern/Althea");
   app.createGame<DemoScene>();
 
@@ -19,4 +47,4 @@ int main() {
   }
 
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
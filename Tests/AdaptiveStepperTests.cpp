@@ -0,0 +1,217 @@
+#include "AdaptiveStepper.h"
+#include "TestFramework.h"
+
+#include <Pies/Solver.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace PiesForAlthea;
+
+namespace {
+constexpr float NODE_RADIUS = 0.5f;
+constexpr float TIME_STEP = 1.0f / 60.0f;
+const glm::vec3 GRAVITY(0.0f, -9.81f, 0.0f);
+
+// Nodes falling onto a floor at y = 0, where they stop dead. Stands in for
+// the solver, whose motion can't be scripted.
+struct FallingNodes {
+  std::vector<Solver::Vertex> vertices;
+  std::vector<glm::vec3> velocities;
+  uint32_t tickCount = 0;
+
+  void addNode(const glm::vec3& position) {
+    Solver::Vertex vertex{};
+    vertex.position = position;
+    vertex.radius = NODE_RADIUS;
+    vertices.push_back(vertex);
+    velocities.push_back(glm::vec3(0.0f));
+  }
+
+  void tick(float deltaTime) {
+    ++tickCount;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      velocities[i] += GRAVITY * deltaTime;
+      vertices[i].position += velocities[i] * deltaTime;
+      if (vertices[i].position.y < 0.0f) {
+        vertices[i].position.y = 0.0f;
+        velocities[i] = glm::vec3(0.0f);
+      }
+    }
+  }
+
+  const AdaptiveStepStats& step(AdaptiveStepper& stepper) {
+    return stepper.step(
+        [this](float deltaTime) { this->tick(deltaTime); },
+        vertices,
+        TIME_STEP);
+  }
+};
+} // namespace
+
+TEST(AdaptiveStepper, ResidualFollowsGravity) {
+  FallingNodes scene;
+  scene.addNode(glm::vec3(0.0f, 100.0f, 0.0f));
+  AdaptiveStepper stepper;
+
+  // Nothing to compare against yet
+  CHECK(stepper.measureResidual(scene.vertices, TIME_STEP) < 0.0f);
+
+  for (uint32_t i = 0; i < 30; ++i) {
+    scene.tick(TIME_STEP);
+    CHECK(stepper.measureResidual(scene.vertices, TIME_STEP) < 1e-3f);
+  }
+}
+
+TEST(AdaptiveStepper, ResidualCatchesImpacts) {
+  FallingNodes scene;
+  scene.addNode(glm::vec3(0.0f, 2.0f, 0.0f));
+  AdaptiveStepper stepper;
+  stepper.measureResidual(scene.vertices, TIME_STEP);
+
+  float maxResidual = 0.0f;
+  for (uint32_t i = 0; i < 60; ++i) {
+    scene.tick(TIME_STEP);
+    maxResidual = std::max(
+        maxResidual,
+        stepper.measureResidual(scene.vertices, TIME_STEP));
+  }
+
+  CHECK(maxResidual > stepper.getOptions().tolerance);
+}
+
+TEST(AdaptiveStepper, SubstepsFollowTheResidual) {
+  FallingNodes scene;
+  scene.addNode(glm::vec3(0.0f, 2.0f, 0.0f));
+
+  AdaptiveStepOptions options{};
+  options.enabled = true;
+  options.sleepSpeed = 0.0f;
+  AdaptiveStepper stepper(options);
+
+  // Free fall converges, so the step finishes after two substeps
+  scene.step(stepper);
+  CHECK(scene.step(stepper).substeps <= 2);
+  CHECK(stepper.getTargetSubsteps() == 1);
+
+  uint32_t maxTarget = 0;
+  for (uint32_t i = 0; i < 60; ++i) {
+    scene.step(stepper);
+    maxTarget = std::max(maxTarget, stepper.getTargetSubsteps());
+  }
+
+  // Refined around the impact, back to single ticks once resting
+  CHECK(maxTarget > 1);
+  CHECK(stepper.getTargetSubsteps() == 1);
+}
+
+TEST(AdaptiveStepper, CalmScenesSleep) {
+  FallingNodes scene;
+  scene.addNode(glm::vec3(0.0f));
+  scene.addNode(glm::vec3(2.0f, 0.0f, 0.0f));
+  AdaptiveStepper stepper;
+  const AdaptiveStepOptions& options = stepper.getOptions();
+
+  // The first step only records where the nodes are
+  uint32_t awakeSteps = options.sleepSteps + 1;
+  for (uint32_t i = 0; i < awakeSteps; ++i) {
+    CHECK(!scene.step(stepper).asleep);
+  }
+  CHECK(stepper.isAsleep());
+
+  uint32_t sleptSteps = 10 * options.sleepInterval;
+  uint32_t ticksBefore = scene.tickCount;
+  for (uint32_t i = 0; i < sleptSteps; ++i) {
+    scene.step(stepper);
+  }
+
+  // Only the steps checking for motion tick the solver
+  CHECK(scene.tickCount - ticksBefore == 10);
+  CHECK(stepper.isAsleep());
+}
+
+TEST(AdaptiveStepper, MotionSpawnsAndRequiredSubstepsWake) {
+  FallingNodes scene;
+  scene.addNode(glm::vec3(0.0f));
+  AdaptiveStepper stepper;
+  const AdaptiveStepOptions& options = stepper.getOptions();
+
+  auto fallAsleep = [&]() {
+    for (uint32_t i = 0; i <= options.sleepSteps; ++i) {
+      scene.step(stepper);
+    }
+    CHECK(stepper.isAsleep());
+    CHECK(scene.step(stepper).asleep);
+  };
+
+  // A kick shows up at the next check
+  fallAsleep();
+  scene.velocities[0] = glm::vec3(1.0f, 0.0f, 0.0f);
+  for (uint32_t i = 0; i < options.sleepInterval; ++i) {
+    scene.step(stepper);
+  }
+  CHECK(!stepper.isAsleep());
+  CHECK(!scene.step(stepper).asleep);
+
+  scene.velocities[0] = glm::vec3(0.0f);
+  fallAsleep();
+  scene.addNode(glm::vec3(5.0f, 0.0f, 0.0f));
+  CHECK(!scene.step(stepper).asleep);
+
+  fallAsleep();
+  stepper.requireSubsteps(3);
+  CHECK(!stepper.isAsleep());
+  CHECK(scene.step(stepper).substeps == 3);
+}
+
+TEST(AdaptiveStepper, SwapsInvertedSubstepRange) {
+  AdaptiveStepOptions options{};
+  options.minSubsteps = 8;
+  options.maxSubsteps = 2;
+  AdaptiveStepper stepper(options);
+  CHECK(stepper.getOptions().minSubsteps == 2);
+  CHECK(stepper.getOptions().maxSubsteps == 8);
+  CHECK(stepper.getTargetSubsteps() == 2);
+
+  options.minSubsteps = 0;
+  options.maxSubsteps = 0;
+  stepper.setOptions(options);
+  stepper.requestSubsteps(100);
+  CHECK(stepper.getTargetSubsteps() == 1);
+}
+
+TEST(AdaptiveStepper, RequiredSubstepsIgnoreDisabledStepper) {
+  Solver solver(SolverOptions{});
+  AdaptiveStepper stepper;
+
+  stepper.requireSubsteps(5);
+  CHECK(stepper.step(solver, TIME_STEP).substeps == 5);
+
+  // Only applies to the next step
+  CHECK(stepper.step(solver, TIME_STEP).substeps == 1);
+}
+
+TEST(AdaptiveStepper, RequiredSubstepsIgnoreConvergenceWithinCap) {
+  Solver solver(SolverOptions{});
+
+  AdaptiveStepOptions options{};
+  options.enabled = true;
+  options.maxSubsteps = 4;
+  AdaptiveStepper stepper(options);
+
+  // An empty solver converges right away, which would otherwise end the
+  // step after the first substep
+  stepper.requireSubsteps(3);
+  CHECK(stepper.step(solver, TIME_STEP).substeps == 3);
+
+  // A governed maximum caps them, enabled or not
+  stepper.requireSubsteps(50);
+  CHECK(stepper.step(solver, TIME_STEP).substeps == 4);
+
+  options.enabled = false;
+  stepper.setOptions(options);
+  stepper.requireSubsteps(50);
+  CHECK(stepper.step(solver, TIME_STEP).substeps == 4);
+}
@@ -0,0 +1,76 @@
+#include "BodyRegistry.h"
+#include "TestFramework.h"
+
+#include <Pies/Solver.h>
+#include <glm/glm.hpp>
+
+using namespace PiesForAlthea;
+
+namespace {
+void checkMatchesSolver(const BodyRegistry& bodies, const Solver& solver) {
+  CHECK(bodies.getNodeCount() == solver.getVertices().size());
+  CHECK(bodies.getLineIndexCount() == solver.getLines().size());
+  CHECK(bodies.getTriangleIndexCount() == solver.getTriangles().size());
+  CHECK(bodies.getNodeBodies().size() == solver.getVertices().size());
+}
+} // namespace
+
+TEST(BodyRegistry, SharesSizesAcrossValueParams) {
+  Solver solver(SolverOptions{});
+  BodyRegistry bodies;
+
+  SpawnRequest request{};
+  request.params.type = BodyType::TET_BOX;
+  uint32_t first = bodies.spawn(solver, request);
+
+  // Pinning, stiffness and mass don't change the topology
+  request.params.pinned = true;
+  request.params.stiffness = 5.0f;
+  request.params.mass = 2.0f;
+  request.translation = glm::vec3(3.0f, 0.0f, 0.0f);
+  uint32_t second = bodies.spawn(solver, request);
+
+  CHECK(bodies.getSizesCount() == 1);
+  CHECK(
+      bodies.getBodies()[first].sizesId ==
+      bodies.getBodies()[second].sizesId);
+  CHECK(
+      bodies.getBodies()[second].firstNode ==
+      bodies.getSizes(bodies.getBodies()[first].sizesId).nodeCount);
+  checkMatchesSolver(bodies, solver);
+}
+
+TEST(BodyRegistry, TracksEveryBodyType) {
+  Solver solver(SolverOptions{});
+  BodyRegistry bodies;
+
+  bodies.spawnTetBox(
+      solver,
+      glm::vec3(0.0f),
+      1.0f,
+      glm::vec3(0.0f),
+      1.0f,
+      1.0f,
+      false);
+  bodies.spawnSheet(solver, glm::vec3(2.0f, 0.0f, 0.0f), 1.0f, 1.0f, 1.0f);
+  bodies.spawnBendSheet(solver, glm::vec3(4.0f, 0.0f, 0.0f), 1.0f, 1.0f);
+
+  CHECK(bodies.getBodies().size() == 3);
+  CHECK(bodies.getSizesCount() == 3);
+  checkMatchesSolver(bodies, solver);
+
+  SpawnParams sheet{};
+  sheet.type = BodyType::SHEET;
+  CHECK(bodies.findSizes(sheet) != nullptr);
+  sheet.scale = 2.0f;
+  CHECK(bodies.findSizes(sheet) == nullptr);
+
+  // The sizes survive a clear so the next spawn can be estimated
+  solver.clear();
+  bodies.clear();
+  CHECK(bodies.getBodies().empty());
+  CHECK(bodies.getSizesCount() == 3);
+  bodies.spawnSheet(solver, glm::vec3(0.0f), 1.0f, 1.0f, 1.0f);
+  CHECK(bodies.getBodies()[0].firstNode == 0);
+  checkMatchesSolver(bodies, solver);
+}
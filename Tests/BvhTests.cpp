@@ -0,0 +1,259 @@
+#include "BinaryIO.h"
+#include "Bvh.h"
+#include "TestFramework.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+using namespace PiesForAlthea;
+
+namespace {
+std::vector<Aabb> makeRandomBounds(uint32_t count, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+  std::uniform_real_distribution<float> size(0.05f, 0.5f);
+
+  std::vector<Aabb> bounds(count);
+  for (Aabb& box : bounds) {
+    glm::vec3 center(position(random), position(random), position(random));
+    box.expand(center);
+    box.inflate(size(random));
+  }
+
+  return bounds;
+}
+
+std::vector<uint32_t> queryBruteForce(
+    const std::vector<Aabb>& bounds,
+    const Aabb& queryBounds) {
+  std::vector<uint32_t> result;
+  for (uint32_t i = 0; i < bounds.size(); ++i) {
+    if (bounds[i].overlaps(queryBounds)) {
+      result.push_back(i);
+    }
+  }
+
+  return result;
+}
+
+std::vector<uint32_t> queryTree(const Bvh& bvh, const Aabb& queryBounds) {
+  std::vector<uint32_t> result;
+  bvh.query(queryBounds, [&](uint32_t primitive) {
+    result.push_back(primitive);
+  });
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+bool matchesBruteForce(const Bvh& bvh, const std::vector<Aabb>& bounds) {
+  std::vector<Aabb> queries = makeRandomBounds(64, 7);
+  for (Aabb& query : queries) {
+    query.inflate(1.0f);
+    if (queryTree(bvh, query) != queryBruteForce(bounds, query)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Triangle bounds of a cloth-like grid, displaced by a travelling wave
+void makeClothBounds(uint32_t size, float time, std::vector<Aabb>& bounds) {
+  auto vertex = [&](uint32_t x, uint32_t z) {
+    float height = 0.3f * std::sin(0.5f * x + time) * std::cos(0.5f * z);
+    return glm::vec3(0.1f * x, height, 0.1f * z);
+  };
+
+  bounds.clear();
+  for (uint32_t z = 0; z + 1 < size; ++z) {
+    for (uint32_t x = 0; x + 1 < size; ++x) {
+      Aabb lower;
+      lower.expand(vertex(x, z));
+      lower.expand(vertex(x + 1, z));
+      lower.expand(vertex(x, z + 1));
+      bounds.push_back(lower);
+
+      Aabb upper;
+      upper.expand(vertex(x + 1, z));
+      upper.expand(vertex(x + 1, z + 1));
+      upper.expand(vertex(x, z + 1));
+      bounds.push_back(upper);
+    }
+  }
+}
+// Mirrors Bvh::Node, to write hand-made trees in the cache layout
+struct RawNode {
+  Aabb bounds;
+  uint32_t first;
+  uint32_t primitiveCount;
+};
+
+// Tree over two primitives whose internal nodes are given as (index, first)
+// pairs, every other node is a leaf holding primitive 0
+bool readRawTree(
+    uint32_t nodeCount,
+    const std::vector<std::pair<uint32_t, uint32_t>>& internalNodes) {
+  Aabb box;
+  box.expand(glm::vec3(0.0f));
+  box.inflate(1.0f);
+
+  std::vector<RawNode> nodes(nodeCount, RawNode{box, 0, 1});
+  for (const auto& internalNode : internalNodes) {
+    nodes[internalNode.first].first = internalNode.second;
+    nodes[internalNode.first].primitiveCount = 0;
+  }
+
+  std::stringstream stream;
+  writeVector(stream, nodes);
+  writeVector(stream, std::vector<uint32_t>{0, 1});
+  writeVector(stream, std::vector<Aabb>{box, box});
+  writeValue(stream, 1.0f);
+
+  Bvh bvh;
+  return bvh.read(stream);
+}
+} // namespace
+
+TEST(Bvh, QueryMatchesBruteForce) {
+  std::vector<Aabb> bounds = makeRandomBounds(5000, 1);
+  Bvh bvh;
+  bvh.build(bounds);
+
+  CHECK(bvh.getPrimitiveCount() == bounds.size());
+  CHECK(bvh.getQualityRatio() == 1.0f);
+  CHECK(matchesBruteForce(bvh, bounds));
+}
+
+TEST(Bvh, RefitTracksMovedPrimitives) {
+  std::vector<Aabb> bounds = makeRandomBounds(5000, 2);
+  Bvh bvh;
+  bvh.build(bounds);
+
+  // Scatter everything, the topology no longer fits the primitives
+  std::vector<Aabb> moved = makeRandomBounds(5000, 3);
+  bvh.refit(moved);
+
+  CHECK(matchesBruteForce(bvh, moved));
+  CHECK(bvh.getQualityRatio() > 1.0f);
+
+  bvh.build(moved);
+  CHECK(bvh.getQualityRatio() == 1.0f);
+}
+
+TEST(Bvh, RaycastFindsNearestPrimitive) {
+  std::vector<Aabb> bounds(3);
+  for (uint32_t i = 0; i < 3; ++i) {
+    bounds[i].expand(glm::vec3(0.0f, 0.0f, 2.0f * i + 2.0f));
+    bounds[i].inflate(0.5f);
+  }
+
+  Bvh bvh;
+  bvh.build(bounds);
+
+  uint32_t nearest = UINT32_MAX;
+  float distance = bvh.raycast(
+      glm::vec3(0.0f),
+      glm::vec3(0.0f, 0.0f, 1.0f),
+      100.0f,
+      [&](uint32_t primitive, float) {
+        float entry = bounds[primitive].min.z;
+        if (entry < 100.0f && (nearest == UINT32_MAX ||
+                               entry < bounds[nearest].min.z)) {
+          nearest = primitive;
+        }
+        return entry;
+      });
+
+  CHECK(nearest == 0);
+  CHECK(std::abs(distance - 1.5f) < 1e-5f);
+}
+
+TEST(Bvh, WriteReadRoundTrip) {
+  std::vector<Aabb> bounds = makeRandomBounds(1000, 4);
+  Bvh bvh;
+  bvh.build(bounds);
+
+  std::stringstream stream;
+  bvh.write(stream);
+
+  Bvh loaded;
+  CHECK(loaded.read(stream));
+  CHECK(loaded.getNodeCount() == bvh.getNodeCount());
+  CHECK(matchesBruteForce(loaded, bounds));
+}
+
+TEST(Bvh, ReadRejectsTruncatedStream) {
+  std::vector<Aabb> bounds = makeRandomBounds(1000, 5);
+  Bvh bvh;
+  bvh.build(bounds);
+
+  std::stringstream stream;
+  bvh.write(stream);
+  std::string data = stream.str();
+
+  std::stringstream truncated(data.substr(0, data.size() / 2));
+  Bvh loaded;
+  CHECK(!loaded.read(truncated));
+  CHECK(loaded.getNodeCount() == 0);
+}
+
+TEST(Bvh, ReadChecksEveryNodeIsReachedOnce) {
+  CHECK(readRawTree(3, {{0, 1}}));
+  CHECK(readRawTree(5, {{0, 1}, {1, 3}}));
+
+  // Two parents sharing the same children
+  CHECK(!readRawTree(5, {{0, 1}, {1, 3}, {2, 3}}));
+  // A node no parent points at
+  CHECK(!readRawTree(4, {{0, 1}}));
+  // Children before their parent
+  CHECK(!readRawTree(5, {{0, 3}, {3, 1}}));
+  // Children past the end, including a wrapping index
+  CHECK(!readRawTree(3, {{0, 2}}));
+  CHECK(!readRawTree(3, {{0, 0xffffffff}}));
+}
+
+TEST(BvhBenchmark, RefitVersusRebuild) {
+  using Clock = std::chrono::steady_clock;
+  constexpr uint32_t FRAMES = 30;
+
+  // About 80k triangles
+  std::vector<Aabb> bounds;
+  makeClothBounds(200, 0.0f, bounds);
+
+  Bvh refitted;
+  refitted.build(bounds);
+  Bvh rebuilt;
+
+  double refitMs = 0.0;
+  double rebuildMs = 0.0;
+  for (uint32_t frame = 1; frame <= FRAMES; ++frame) {
+    makeClothBounds(200, 0.1f * frame, bounds);
+
+    Clock::time_point startTime = Clock::now();
+    refitted.refit(bounds);
+    refitMs +=
+        std::chrono::duration<double, std::milli>(Clock::now() - startTime)
+            .count();
+
+    startTime = Clock::now();
+    rebuilt.build(bounds);
+    rebuildMs +=
+        std::chrono::duration<double, std::milli>(Clock::now() - startTime)
+            .count();
+  }
+
+  CHECK(matchesBruteForce(refitted, bounds));
+  std::cout << "  " << bounds.size() << " triangles: refit "
+            << refitMs / FRAMES << " ms, rebuild " << rebuildMs / FRAMES
+            << " ms, refitted quality ratio " << refitted.getQualityRatio()
+            << std::endl;
+}
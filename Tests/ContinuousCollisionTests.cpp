@@ -0,0 +1,177 @@
+#include "AdaptiveStepper.h"
+#include "ContinuousCollision.h"
+#include "TestFramework.h"
+
+#include <Pies/Solver.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace PiesForAlthea;
+
+namespace {
+constexpr float NODE_RADIUS = 0.1f;
+constexpr float TIME_STEP = 1.0f / 60.0f;
+
+Solver::Vertex makeVertex(const glm::vec3& position) {
+  Solver::Vertex vertex{};
+  vertex.position = position;
+  vertex.radius = NODE_RADIUS;
+  return vertex;
+}
+
+// A single node (body 0) above a one node thick sheet (body 1) at y = 0
+struct SheetDrop {
+  std::vector<Solver::Vertex> vertices;
+  std::vector<uint32_t> nodeBodies;
+  glm::vec3 velocity;
+  bool caught = false;
+
+  SheetDrop(float height, float speed) : velocity(0.0f, -speed, 0.0f) {
+    // Dropped between sheet nodes, where the gap is widest
+    vertices.push_back(makeVertex(glm::vec3(0.1f, height, 0.1f)));
+    nodeBodies.push_back(0);
+
+    float spacing = 2.0f * NODE_RADIUS;
+    for (int32_t x = -4; x <= 4; ++x) {
+      for (int32_t z = -4; z <= 4; ++z) {
+        vertices.push_back(
+            makeVertex(glm::vec3(x * spacing, 0.0f, z * spacing)));
+        nodeBodies.push_back(1);
+      }
+    }
+  }
+
+  // Stands in for the solver's discrete collisions, which only see the
+  // node if it ends a tick touching the sheet
+  void tick(float deltaTime) {
+    if (caught) {
+      return;
+    }
+
+    vertices[0].position += velocity * deltaTime;
+    for (size_t i = 1; i < vertices.size(); ++i) {
+      float distance =
+          glm::length(vertices[0].position - vertices[i].position);
+      if (distance <= 2.0f * NODE_RADIUS * 1.001f) {
+        caught = true;
+        velocity = glm::vec3(0.0f);
+        return;
+      }
+    }
+  }
+
+  // Returns the number of ticks the step took
+  uint32_t step(ContinuousCollision& ccd, AdaptiveStepper& stepper) {
+    uint32_t ticks = 0;
+    ccd.step(
+        [this, &ticks](float deltaTime) {
+          ++ticks;
+          this->tick(deltaTime);
+        },
+        vertices,
+        stepper,
+        nodeBodies,
+        TIME_STEP);
+
+    return ticks;
+  }
+};
+
+ContinuousCollision makeCcd(bool enabled) {
+  ContinuousCollisionOptions options{};
+  options.enabled = enabled;
+  options.floorHeight = -100.0f;
+  return ContinuousCollision(options);
+}
+
+void seedDrop(ContinuousCollision& ccd, const SheetDrop& drop) {
+  ccd.seedNodes(drop.vertices, 0, 1, drop.velocity);
+  ccd.seedNodes(
+      drop.vertices,
+      1,
+      static_cast<uint32_t>(drop.vertices.size() - 1),
+      glm::vec3(0.0f));
+}
+
+bool dropThroughSheet(bool ccdEnabled) {
+  ContinuousCollision ccd = makeCcd(ccdEnabled);
+  AdaptiveStepper stepper;
+
+  // Falls about 17 node radii per step
+  SheetDrop drop(10.0f, 100.0f);
+  seedDrop(ccd, drop);
+
+  for (uint32_t frame = 0; frame < 20; ++frame) {
+    drop.step(ccd, stepper);
+  }
+
+  return drop.vertices[0].position.y < 0.0f;
+}
+} // namespace
+
+TEST(ContinuousCollision, DroppedNodeTunnelsWithoutSweep) {
+  CHECK(dropThroughSheet(false));
+}
+
+TEST(ContinuousCollision, DroppedNodeStopsAtThinSheet) {
+  CHECK(!dropThroughSheet(true));
+}
+
+TEST(ContinuousCollision, SplitStepsStayWithinStepperCap) {
+  ContinuousCollision ccd = makeCcd(true);
+  AdaptiveStepOptions stepOptions{};
+  stepOptions.maxSubsteps = 2;
+  AdaptiveStepper stepper(stepOptions);
+
+  SheetDrop drop(10.0f, 100.0f);
+  seedDrop(ccd, drop);
+
+  // Every piece of a split step is one stepper step
+  uint32_t maxTicks = (ccd.getOptions().maxImpactSplits + 1) * 2;
+  uint32_t mostTicks = 0;
+  for (uint32_t frame = 0; frame < 20; ++frame) {
+    mostTicks = std::max(mostTicks, drop.step(ccd, stepper));
+  }
+
+  CHECK(mostTicks > 1);
+  CHECK(mostTicks <= maxTicks);
+  CHECK(drop.caught);
+  CHECK(drop.vertices[0].position.y > 0.0f);
+}
+
+TEST(ContinuousCollision, FindsImpactBetweenFastNodes) {
+  ContinuousCollision ccd;
+
+  // Two nodes of different bodies flying head on, each far too fast to
+  // find the other in its own starting cell
+  std::vector<Solver::Vertex> vertices = {
+      makeVertex(glm::vec3(-2.0f, 5.0f, 0.0f)),
+      makeVertex(glm::vec3(2.0f, 5.0f, 0.0f))};
+  std::vector<uint32_t> nodeBodies = {0, 1};
+  ccd.seedNodes(vertices, 0, 1, glm::vec3(120.0f, 0.0f, 0.0f));
+  ccd.seedNodes(vertices, 1, 1, glm::vec3(-120.0f, 0.0f, 0.0f));
+
+  float toi = ccd.findEarliestImpact(vertices, nodeBodies, TIME_STEP);
+  // They touch once the 3.8 gap between their surfaces has closed
+  float expectedToi = 3.8f / (240.0f * TIME_STEP);
+  CHECK(std::abs(toi - expectedToi) < 1e-3f);
+  CHECK(ccd.getFastNodeCount() == 2);
+  CHECK(ccd.getRequiredSubsteps() > 1);
+}
+
+TEST(ContinuousCollision, IgnoresNodesOfTheSameBody) {
+  ContinuousCollision ccd;
+
+  std::vector<Solver::Vertex> vertices = {
+      makeVertex(glm::vec3(0.0f, 5.0f, 0.0f)),
+      makeVertex(glm::vec3(1.0f, 5.0f, 0.0f))};
+  std::vector<uint32_t> nodeBodies = {0, 0};
+  ccd.seedNodes(vertices, 0, 1, glm::vec3(120.0f, 0.0f, 0.0f));
+  ccd.seedNodes(vertices, 1, 1, glm::vec3(0.0f));
+
+  CHECK(ccd.findEarliestImpact(vertices, nodeBodies, TIME_STEP) == 1.0f);
+}
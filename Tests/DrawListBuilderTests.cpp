@@ -0,0 +1,172 @@
+#include "DrawListBuilder.h"
+#include "TestFramework.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+using namespace PiesForAlthea;
+
+namespace {
+// Bodies with 24 line indices, 36 triangle indices and 8 nodes each, laid
+// out back to back the way the solver appends them
+std::vector<BodyDrawRange> makeRanges(uint32_t bodyCount) {
+  std::vector<BodyDrawRange> ranges(bodyCount);
+  for (uint32_t i = 0; i < bodyCount; ++i) {
+    ranges[i].firstLineIndex = 24 * i;
+    ranges[i].lineIndexCount = 24;
+    ranges[i].firstTriangleIndex = 36 * i;
+    ranges[i].triangleIndexCount = 36;
+    ranges[i].firstNode = 8 * i;
+    ranges[i].nodeCount = 8;
+  }
+
+  return ranges;
+}
+} // namespace
+
+TEST(DrawListBuilder, MergesFullyVisibleScene) {
+  DrawListBuilder builder;
+  builder.setBodies(makeRanges(100));
+
+  const std::vector<VkDrawIndexedIndirectCommand>& triangles =
+      builder.build(DrawListType::TRIANGLES);
+  CHECK(triangles.size() == 1);
+  CHECK(triangles[0].firstIndex == 0);
+  CHECK(triangles[0].indexCount == 3600);
+  CHECK(triangles[0].instanceCount == 1);
+  CHECK(triangles[0].firstInstance == 0);
+
+  const std::vector<VkDrawIndexedIndirectCommand>& nodes =
+      builder.build(DrawListType::NODES, 60);
+  CHECK(nodes.size() == 1);
+  CHECK(nodes[0].indexCount == 60);
+  CHECK(nodes[0].instanceCount == 800);
+  CHECK(nodes[0].firstInstance == 0);
+}
+
+TEST(DrawListBuilder, SplitsAroundHiddenBodies) {
+  DrawListBuilder builder;
+  builder.setBodies(makeRanges(5));
+  builder.setVisible(1, false);
+  builder.setVisible(3, false);
+
+  const std::vector<VkDrawIndexedIndirectCommand>& lines =
+      builder.build(DrawListType::LINES);
+  CHECK(lines.size() == 3);
+  CHECK(lines[0].firstIndex == 0 && lines[0].indexCount == 24);
+  CHECK(lines[1].firstIndex == 48 && lines[1].indexCount == 24);
+  CHECK(lines[2].firstIndex == 96 && lines[2].indexCount == 24);
+
+  const std::vector<VkDrawIndexedIndirectCommand>& nodes =
+      builder.build(DrawListType::NODES, 60);
+  CHECK(nodes.size() == 3);
+  CHECK(nodes[1].firstInstance == 16 && nodes[1].instanceCount == 8);
+
+  builder.setAllVisible(false);
+  CHECK(builder.build(DrawListType::TRIANGLES).empty());
+}
+
+TEST(DrawListBuilder, MergesAcrossEmptyBodies) {
+  std::vector<BodyDrawRange> ranges = makeRanges(3);
+  // A body without triangles, e.g. a tet box drawn only as lines
+  ranges[1].triangleIndexCount = 0;
+  ranges[2].firstTriangleIndex = 36;
+
+  DrawListBuilder builder;
+  builder.setBodies(std::move(ranges));
+  const std::vector<VkDrawIndexedIndirectCommand>& triangles =
+      builder.build(DrawListType::TRIANGLES);
+  CHECK(triangles.size() == 1);
+  CHECK(triangles[0].indexCount == 72);
+
+  // Hiding the empty body doesn't break the run either
+  builder.setVisible(1, false);
+  CHECK(builder.build(DrawListType::TRIANGLES).size() == 1);
+}
+
+TEST(DrawListBuilder, KeepsVisibilityOfKnownBodies) {
+  DrawListBuilder builder;
+  builder.setBodies(makeRanges(2));
+  builder.setVisible(0, false);
+  // Bodies spawned since the last setBodies can be hidden up front
+  builder.setVisible(3, false);
+
+  builder.setBodies(makeRanges(4));
+  CHECK(!builder.isVisible(0));
+  CHECK(builder.isVisible(1));
+  CHECK(builder.isVisible(2));
+  CHECK(!builder.isVisible(3));
+  CHECK(builder.build(DrawListType::LINES).size() == 1);
+}
+
+TEST(DrawListBuilder, SplitsRangesThatArentBackToBack) {
+  std::vector<BodyDrawRange> ranges = makeRanges(3);
+  std::swap(ranges[0], ranges[2]);
+
+  DrawListBuilder builder;
+  builder.setBodies(std::move(ranges));
+  const std::vector<VkDrawIndexedIndirectCommand>& lines =
+      builder.build(DrawListType::LINES);
+  CHECK(lines.size() == 3);
+  CHECK(lines[0].firstIndex == 48 && lines[0].indexCount == 24);
+  CHECK(lines[2].firstIndex == 0 && lines[2].indexCount == 24);
+
+  const std::vector<VkDrawIndexedIndirectCommand>& nodes =
+      builder.build(DrawListType::NODES, 60);
+  CHECK(nodes.size() == 3);
+  CHECK(nodes[1].firstInstance == 8 && nodes[1].instanceCount == 8);
+}
+
+TEST(DrawListBuilder, ClearForgetsVisibility) {
+  DrawListBuilder builder;
+  builder.setBodies(makeRanges(2));
+  builder.setVisible(0, false);
+  builder.setVisible(3, false);
+
+  builder.clear();
+  CHECK(builder.getBodyCount() == 0);
+  CHECK(builder.build(DrawListType::LINES).empty());
+
+  // Fresh bodies reuse the ids, but not the old visibility
+  builder.setBodies(makeRanges(4));
+  CHECK(builder.isVisible(0));
+  CHECK(builder.isVisible(3));
+  CHECK(builder.build(DrawListType::LINES).size() == 1);
+}
+
+TEST(DrawListBuilderBenchmark, Build100kBodies) {
+  using Clock = std::chrono::steady_clock;
+  constexpr uint32_t BODY_COUNT = 100000;
+  constexpr uint32_t ITERATIONS = 20;
+
+  DrawListBuilder builder;
+  builder.setBodies(makeRanges(BODY_COUNT));
+
+  auto measureMs = [&](DrawListType type, size_t expectedDrawCount) {
+    Clock::time_point startTime = Clock::now();
+    for (uint32_t i = 0; i < ITERATIONS; ++i) {
+      CHECK(builder.build(type, 60).size() == expectedDrawCount);
+    }
+
+    return std::chrono::duration<double, std::milli>(
+               Clock::now() - startTime)
+               .count() /
+           ITERATIONS;
+  };
+
+  double visibleMs = measureMs(DrawListType::TRIANGLES, 1);
+
+  // Worst case for merging, every other body hidden
+  for (uint32_t i = 0; i < BODY_COUNT; i += 2) {
+    builder.setVisible(i, false);
+  }
+  double alternatingMs = measureMs(DrawListType::TRIANGLES, BODY_COUNT / 2);
+  double nodesMs = measureMs(DrawListType::NODES, BODY_COUNT / 2);
+
+  std::cout << "  100k bodies: all visible " << visibleMs
+            << " ms, alternating " << alternatingMs << " ms, nodes "
+            << nodesMs << " ms" << std::endl;
+}
@@ -0,0 +1,167 @@
+#include "FrameExportReader.h"
+#include "FrameExporter.h"
+#include "TestFramework.h"
+
+#include <Pies/Solver.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace PiesForAlthea;
+
+#ifndef _WIN32
+namespace {
+constexpr uint64_t FRAME_COUNT = 3000;
+// Enough nodes to outgrow the initial segment halfway through
+constexpr uint64_t GROW_FRAME = FRAME_COUNT / 2;
+
+uint32_t getNodeCount(uint64_t frameIndex) {
+  return frameIndex < GROW_FRAME ? 500 : 3000;
+}
+
+// Node i of frame f sits at (f, i, -f), so a frame mixed from two writes
+// shows up as mismatching coordinates
+void fillFrame(uint64_t frameIndex, std::vector<Solver::Vertex>& vertices) {
+  vertices.resize(getNodeCount(frameIndex));
+  for (uint32_t i = 0; i < vertices.size(); ++i) {
+    float frame = static_cast<float>(frameIndex);
+    vertices[i].position = glm::vec3(frame, static_cast<float>(i), -frame);
+    vertices[i].radius = 0.5f;
+  }
+}
+
+bool isConsistent(
+    const std::vector<FrameExportNode>& nodes,
+    uint64_t frameIndex,
+    uint64_t topologyVersion) {
+  if (nodes.size() != getNodeCount(frameIndex) ||
+      topologyVersion != (frameIndex < GROW_FRAME ? 1 : 2)) {
+    return false;
+  }
+
+  float frame = static_cast<float>(frameIndex);
+  for (uint32_t i = 0; i < nodes.size(); ++i) {
+    if (nodes[i].position[0] != frame ||
+        nodes[i].position[1] != static_cast<float>(i) ||
+        nodes[i].position[2] != -frame || nodes[i].radius != 0.5f) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Runs in the forked reader process, returns the exit status
+int runReader(const std::string& name) {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point deadline = Clock::now() + std::chrono::seconds(20);
+
+  FrameExportReader reader;
+  while (!reader.open(name)) {
+    if (Clock::now() > deadline) {
+      return 2;
+    }
+    std::this_thread::yield();
+  }
+
+  std::vector<FrameExportNode> nodes;
+  uint64_t lastFrameIndex = 0;
+  uint32_t readCount = 0;
+  while (Clock::now() < deadline) {
+    uint64_t frameIndex = 0;
+    uint64_t topologyVersion = 0;
+    if (!reader.readLatest(nodes, frameIndex, topologyVersion)) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    if (!isConsistent(nodes, frameIndex, topologyVersion)) {
+      return 3;
+    }
+
+    // Frames only ever move forward
+    if (readCount > 0 && frameIndex < lastFrameIndex) {
+      return 4;
+    }
+
+    lastFrameIndex = frameIndex;
+    ++readCount;
+    if (frameIndex == FRAME_COUNT - 1) {
+      return 0;
+    }
+  }
+
+  return 5;
+}
+} // namespace
+
+TEST(FrameExport, ReaderProcessSeesConsistentFrames) {
+  std::string name = "/pies-test-" + std::to_string(getpid());
+
+  FrameExporter exporter;
+  CHECK(exporter.open(name, 3));
+
+  pid_t reader = fork();
+  CHECK(reader >= 0);
+  if (reader == 0) {
+    // Skips static destructors, the worker pool's threads don't exist in
+    // this process
+    _exit(runReader(name));
+  }
+
+  std::vector<Solver::Vertex> vertices;
+  for (uint64_t frameIndex = 0; frameIndex < FRAME_COUNT; ++frameIndex) {
+    fillFrame(frameIndex, vertices);
+    exporter.publish(vertices, frameIndex < GROW_FRAME ? 1 : 2);
+    // Gives the reader a chance to overlap with the writer
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+  CHECK(exporter.getPublishedFrames() == FRAME_COUNT);
+
+  // Keep the last frame up until the reader has seen it
+  int status = 0;
+  CHECK(waitpid(reader, &status, 0) == reader);
+  exporter.close();
+
+  CHECK(WIFEXITED(status));
+  CHECK(WEXITSTATUS(status) == 0);
+}
+
+TEST(FrameExport, ReaderFollowsClose) {
+  std::string name = "/pies-test-close-" + std::to_string(getpid());
+
+  FrameExportReader reader;
+  CHECK(!reader.open(name));
+
+  FrameExporter exporter;
+  CHECK(exporter.open(name));
+  CHECK(reader.open(name));
+
+  FrameView view;
+  CHECK(reader.beginRead(view) == FrameReadStatus::NO_FRAME);
+
+  std::vector<Solver::Vertex> vertices;
+  fillFrame(0, vertices);
+  exporter.publish(vertices, 1);
+  CHECK(reader.beginRead(view) == FrameReadStatus::OK);
+  CHECK(view.nodeCount == vertices.size());
+  CHECK(reader.endRead(view));
+
+  exporter.close();
+  CHECK(reader.beginRead(view) == FrameReadStatus::CLOSED);
+
+  // The segment is gone, so there is nothing to reopen
+  std::vector<FrameExportNode> nodes;
+  uint64_t frameIndex = 0;
+  uint64_t topologyVersion = 0;
+  CHECK(!reader.readLatest(nodes, frameIndex, topologyVersion));
+}
+#endif
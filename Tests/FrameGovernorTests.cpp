@@ -0,0 +1,154 @@
+#include "FrameGovernor.h"
+#include "TestFramework.h"
+
+#include <cstdint>
+
+using namespace PiesForAlthea;
+
+namespace {
+// Drives the governor from a fake clock, every frame costs frameMs
+struct FakeFrames {
+  double nowMs = 0.0;
+  FrameGovernor governor;
+
+  FakeFrames(const FrameGovernorOptions& options)
+      : governor(options, [this]() { return this->nowMs; }) {}
+
+  // Returns how often the level changed
+  uint32_t run(uint32_t frameCount, double frameMs) {
+    uint32_t changes = 0;
+    for (uint32_t i = 0; i < frameCount; ++i) {
+      double startMs = governor.now();
+      nowMs += frameMs;
+      governor.addSolverMs(governor.now() - startMs);
+      if (governor.endFrame()) {
+        ++changes;
+      }
+    }
+
+    return changes;
+  }
+};
+
+FrameGovernorOptions makeEnabledOptions() {
+  FrameGovernorOptions options{};
+  options.enabled = true;
+  options.targetFrameMs = 10.0f;
+  options.degradeFrames = 3;
+  options.recoverFrames = 5;
+  options.smoothing = 1.0f;
+  return options;
+}
+} // namespace
+
+TEST(FrameGovernor, DisabledByDefault) {
+  FrameGovernorOptions options{};
+  CHECK(!options.enabled);
+  CHECK(options.maxLogSize == 0);
+
+  FakeFrames frames(options);
+  CHECK(frames.run(100, 1000.0) == 0);
+  CHECK(frames.governor.getLevel() == 0);
+}
+
+TEST(FrameGovernor, DegradesAfterConsecutiveSlowFrames) {
+  FakeFrames frames(makeEnabledOptions());
+
+  CHECK(frames.run(2, 20.0) == 0);
+  CHECK(frames.run(1, 20.0) == 1);
+  CHECK(frames.governor.getLevel() == 1);
+  CHECK(frames.governor.getSettings().substepDivisor == 2);
+
+  // A new level starts counting from scratch
+  CHECK(frames.run(2, 20.0) == 0);
+  CHECK(frames.run(1, 20.0) == 1);
+  CHECK(frames.governor.getLevel() == 2);
+}
+
+TEST(FrameGovernor, StopsAtLowestQuality) {
+  FakeFrames frames(makeEnabledOptions());
+  frames.run(1000, 100.0);
+  CHECK(frames.governor.getLevel() == FrameGovernor::getLevelCount() - 1);
+  CHECK(frames.governor.getLog().size() == FrameGovernor::getLevelCount() - 1);
+}
+
+TEST(FrameGovernor, LowerLevelsCutSolverWork) {
+  FakeFrames frames(makeEnabledOptions());
+  QualitySettings previous = frames.governor.getSettings();
+  for (uint32_t level = 1; level < FrameGovernor::getLevelCount(); ++level) {
+    frames.run(3, 100.0);
+    CHECK(frames.governor.getLevel() == level);
+
+    const QualitySettings& settings = frames.governor.getSettings();
+    CHECK(settings.substepDivisor >= previous.substepDivisor);
+    CHECK(settings.maxImpactSplits <= previous.maxImpactSplits);
+    previous = settings;
+  }
+
+  // Impacts are still split once at the lowest level
+  CHECK(previous.substepDivisor > 1);
+  CHECK(previous.maxImpactSplits >= 1);
+}
+
+TEST(FrameGovernor, RecoversAfterConsecutiveFastFrames) {
+  FakeFrames frames(makeEnabledOptions());
+  frames.run(3, 20.0);
+  CHECK(frames.governor.getLevel() == 1);
+
+  // Between the recover and degrade thresholds nothing happens
+  CHECK(frames.run(50, 8.0) == 0);
+
+  CHECK(frames.run(4, 1.0) == 0);
+  CHECK(frames.run(1, 1.0) == 1);
+  CHECK(frames.governor.getLevel() == 0);
+
+  const GovernorDecision& decision = frames.governor.getLog().back();
+  CHECK(decision.fromLevel == 1);
+  CHECK(decision.toLevel == 0);
+  CHECK(decision.solverMs == 1.0f);
+}
+
+TEST(FrameGovernor, DisablingRestoresFullQuality) {
+  FakeFrames frames(makeEnabledOptions());
+  frames.run(3, 20.0);
+  CHECK(frames.governor.getLevel() == 1);
+
+  FrameGovernorOptions options = makeEnabledOptions();
+  options.enabled = false;
+  frames.governor.setOptions(options);
+  CHECK(frames.run(1, 20.0) == 1);
+  CHECK(frames.governor.getLevel() == 0);
+}
+
+TEST(FrameGovernor, LogLimitIsOptIn) {
+  FrameGovernorOptions options = makeEnabledOptions();
+  options.recoverFrames = 1;
+  options.recoverRatio = 0.9f;
+  FakeFrames frames(options);
+
+  // Bounce between the first two levels
+  for (uint32_t i = 0; i < 20; ++i) {
+    frames.run(3, 20.0);
+    frames.run(1, 1.0);
+  }
+  CHECK(frames.governor.getLog().size() == 40);
+
+  options.maxLogSize = 8;
+  frames.governor.setOptions(options);
+  CHECK(frames.governor.getLog().size() == 8);
+
+  frames.run(3, 20.0);
+  CHECK(frames.governor.getLog().size() == 8);
+  CHECK(frames.governor.getLog().back().toLevel == 1);
+}
+
+TEST(FrameGovernor, ClockCanBeReplaced) {
+  FrameGovernor governor;
+  double fakeMs = 42.0;
+  governor.setClock([&fakeMs]() { return fakeMs; });
+  CHECK(governor.now() == 42.0);
+
+  // Falls back to the wall clock
+  governor.setClock({});
+  CHECK(governor.now() != 42.0);
+}
@@ -0,0 +1,65 @@
+#include "ParallelFor.h"
+#include "TestFramework.h"
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using namespace PiesForAlthea;
+
+TEST(ParallelFor, VisitsEveryIndexOnce) {
+  std::vector<std::atomic<uint32_t>> visits(100000);
+  parallelFor(visits.size(), 64, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      ++visits[i];
+    }
+  });
+
+  bool once = true;
+  for (const std::atomic<uint32_t>& count : visits) {
+    once = once && count == 1;
+  }
+  CHECK(once);
+}
+
+TEST(ParallelFor, NestedCallsFinish) {
+  std::atomic<size_t> total = 0;
+  parallelFor(64, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      parallelFor(1000, 10, [&](size_t innerBegin, size_t innerEnd) {
+        total += innerEnd - innerBegin;
+      });
+    }
+  });
+
+  CHECK(total == 64 * 1000);
+}
+
+TEST(ParallelFor, RethrowsAfterAllChunksFinish) {
+  // Throws from a chunk in the middle, which may run on a worker
+  for (uint32_t attempt = 0; attempt < 100; ++attempt) {
+    std::atomic<size_t> visited = 0;
+    bool threw = false;
+    try {
+      parallelFor(10000, 1, [&](size_t begin, size_t end) {
+        visited += end - begin;
+        if (begin <= 5000 && 5000 < end) {
+          throw std::runtime_error("chunk failed");
+        }
+      });
+    } catch (const std::runtime_error&) {
+      threw = true;
+    }
+
+    CHECK(threw);
+    CHECK(visited == 10000);
+  }
+
+  // The pool keeps working afterwards
+  std::atomic<size_t> total = 0;
+  parallelFor(10000, 1, [&](size_t begin, size_t end) {
+    total += end - begin;
+  });
+  CHECK(total == 10000);
+}
@@ -0,0 +1,181 @@
+#include "SceneQuery.h"
+#include "StaticEnvironment.h"
+#include "TestFramework.h"
+
+#include <Pies/Solver.h>
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace PiesForAlthea;
+
+namespace {
+constexpr float NODE_RADIUS = 0.25f;
+
+// Stands in for the solver's lists and the registry's node bodies
+struct Scene {
+  std::vector<Solver::Vertex> vertices;
+  std::vector<uint32_t> triangles;
+  std::vector<uint32_t> nodeBodies;
+  uint64_t topologyVersion = 0;
+
+  uint32_t addNode(const glm::vec3& position, uint32_t bodyId) {
+    Solver::Vertex vertex{};
+    vertex.position = position;
+    vertex.radius = NODE_RADIUS;
+    vertices.push_back(vertex);
+    nodeBodies.push_back(bodyId);
+    ++topologyVersion;
+    return static_cast<uint32_t>(vertices.size() - 1);
+  }
+
+  // Unit triangle in the xz-plane at the given height
+  void addTriangle(float height, uint32_t bodyId) {
+    uint32_t a = addNode(glm::vec3(0.0f, height, 0.0f), bodyId);
+    uint32_t b = addNode(glm::vec3(1.0f, height, 0.0f), bodyId);
+    uint32_t c = addNode(glm::vec3(0.0f, height, 1.0f), bodyId);
+    triangles.insert(triangles.end(), {a, b, c});
+  }
+
+  void update(SceneQuery& query) const {
+    query.update(vertices, triangles, nodeBodies, topologyVersion);
+  }
+};
+
+Ray makeDownRay(const glm::vec3& origin) {
+  Ray ray{};
+  ray.origin = origin;
+  ray.direction = glm::vec3(0.0f, -2.0f, 0.0f);
+  return ray;
+}
+
+bool isNear(float a, float b) { return std::abs(a - b) < 1e-4f; }
+} // namespace
+
+TEST(SceneQuery, HitsNearestNode) {
+  Scene scene;
+  scene.addNode(glm::vec3(0.0f, 0.0f, 0.0f), 0);
+  scene.addNode(glm::vec3(0.0f, 3.0f, 0.0f), 1);
+  SceneQuery query;
+  scene.update(query);
+
+  RayHit hit = query.raycast(makeDownRay(glm::vec3(0.0f, 10.0f, 0.0f)));
+  CHECK(hit.type == RayHitType::NODE);
+  CHECK(hit.index == 1);
+  CHECK(hit.bodyId == 1);
+  // The direction isn't normalized, distances still are in world units
+  CHECK(isNear(hit.distance, 7.0f - NODE_RADIUS));
+  CHECK(isNear(hit.normal.y, 1.0f));
+
+  Ray miss = makeDownRay(glm::vec3(5.0f, 10.0f, 0.0f));
+  CHECK(query.raycast(miss).type == RayHitType::NONE);
+  miss = makeDownRay(glm::vec3(0.0f, 10.0f, 0.0f));
+  miss.maxDistance = 5.0f;
+  CHECK(query.raycast(miss).type == RayHitType::NONE);
+}
+
+TEST(SceneQuery, HitsTrianglesFacingTheRay) {
+  Scene scene;
+  scene.addTriangle(0.0f, 2);
+  SceneQuery query;
+  scene.update(query);
+
+  // Between the corner nodes, so only the triangle is in the way
+  for (float originY : {5.0f, -5.0f}) {
+    Ray ray = makeDownRay(glm::vec3(0.3f, originY, 0.3f));
+    ray.direction *= originY > 0.0f ? 1.0f : -1.0f;
+
+    RayHit hit = query.raycast(ray);
+    CHECK(hit.type == RayHitType::TRIANGLE);
+    CHECK(hit.index == 0);
+    CHECK(hit.bodyId == 2);
+    CHECK(isNear(hit.distance, 5.0f));
+    CHECK(isNear(hit.position.y, 0.0f));
+    CHECK(glm::dot(hit.normal, ray.direction) < 0.0f);
+  }
+}
+
+TEST(SceneQuery, OrdersStaticAndDynamicHits) {
+  StaticEnvironment environment;
+  environment.addHeightfield(
+      {0.0f, 0.0f, 0.0f, 0.0f},
+      2,
+      2,
+      glm::vec3(-5.0f, 0.0f, -5.0f),
+      10.0f);
+  environment.build();
+
+  Scene scene;
+  scene.addNode(glm::vec3(0.0f, 2.0f, 0.0f), 0);
+  scene.addNode(glm::vec3(3.0f, -2.0f, 0.0f), 1);
+  SceneQuery query;
+  query.setEnvironment(&environment);
+  scene.update(query);
+
+  // Above the ground the node is hit first
+  RayHit hit = query.raycast(makeDownRay(glm::vec3(0.0f, 10.0f, 0.0f)));
+  CHECK(hit.type == RayHitType::NODE);
+  CHECK(hit.bodyId == 0);
+
+  // The ground hides the node below it
+  hit = query.raycast(makeDownRay(glm::vec3(3.0f, 10.0f, 0.0f)));
+  CHECK(hit.type == RayHitType::STATIC);
+  CHECK(hit.bodyId == STATIC_BODY_ID);
+  CHECK(isNear(hit.distance, 10.0f));
+  CHECK(isNear(hit.normal.y, 1.0f));
+}
+
+TEST(SceneQuery, RefitsMovedNodes) {
+  Scene scene;
+  scene.addNode(glm::vec3(0.0f), 0);
+  SceneQuery query;
+  scene.update(query);
+
+  scene.vertices[0].position = glm::vec3(4.0f, 0.0f, 0.0f);
+  scene.update(query);
+
+  CHECK(
+      query.raycast(makeDownRay(glm::vec3(0.0f, 10.0f, 0.0f))).type ==
+      RayHitType::NONE);
+  CHECK(
+      query.raycast(makeDownRay(glm::vec3(4.0f, 10.0f, 0.0f))).type ==
+      RayHitType::NODE);
+
+  std::vector<Ray> rays = {
+      makeDownRay(glm::vec3(0.0f, 10.0f, 0.0f)),
+      makeDownRay(glm::vec3(4.0f, 10.0f, 0.0f))};
+  std::vector<RayHit> hits;
+  query.raycast(rays, hits);
+  CHECK(hits.size() == 2);
+  CHECK(hits[0].type == RayHitType::NONE);
+  CHECK(hits[1].type == RayHitType::NODE);
+}
+
+TEST(SceneQuery, RebuildsOnTopologyVersion) {
+  Scene scene;
+  scene.addTriangle(0.0f, 0);
+  SceneQuery query;
+  scene.update(query);
+
+  // Same counts after a clear and respawn, only the version tells them
+  // apart
+  scene.nodeBodies.assign(scene.nodeBodies.size(), 1);
+  scene.triangles = {2, 1, 0};
+  ++scene.topologyVersion;
+  scene.update(query);
+
+  RayHit hit = query.raycast(makeDownRay(glm::vec3(0.3f, 5.0f, 0.3f)));
+  CHECK(hit.type == RayHitType::TRIANGLE);
+  CHECK(hit.bodyId == 1);
+
+  query.clear();
+  CHECK(
+      query.raycast(makeDownRay(glm::vec3(0.3f, 5.0f, 0.3f))).type ==
+      RayHitType::NONE);
+  scene.update(query);
+  CHECK(
+      query.raycast(makeDownRay(glm::vec3(0.3f, 5.0f, 0.3f))).type ==
+      RayHitType::TRIANGLE);
+}
@@ -0,0 +1,151 @@
+#include "StagingRing.h"
+#include "TestFramework.h"
+
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+using namespace PiesForAlthea;
+
+namespace {
+// Stands in for the GPU, fences complete a fixed number of frames after
+// they were submitted
+struct FakeFences {
+  uint32_t latency;
+  uint64_t submitted = 0;
+
+  void endFrame(StagingRing& ring) {
+    ring.submit(++submitted);
+    if (submitted > latency) {
+      ring.retire(submitted - latency);
+    }
+  }
+};
+
+bool overlaps(
+    const StagingRing::Allocation& a,
+    const StagingRing::Allocation& b) {
+  return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+} // namespace
+
+TEST(StagingRing, AlignsAndRejectsOversized) {
+  StagingRing ring(1024);
+  StagingRing::Allocation allocation;
+
+  CHECK(ring.allocate(10, 1, allocation));
+  CHECK(allocation.offset == 0);
+  CHECK(ring.allocate(16, 64, allocation));
+  CHECK(allocation.offset == 64);
+  CHECK(ring.getUsedBytes() == 80);
+
+  CHECK(!ring.allocate(0, 1, allocation));
+  CHECK(!ring.allocate(2048, 1, allocation));
+}
+
+TEST(StagingRing, ReusesSpaceOnlyOnceRetired) {
+  StagingRing ring(1024);
+  FakeFences fences{2};
+  StagingRing::Allocation allocation;
+
+  CHECK(ring.allocate(600, 1, allocation));
+  fences.endFrame(ring);
+  // Still in flight, the rest of the ring is too small
+  CHECK(!ring.allocate(600, 1, allocation));
+
+  fences.endFrame(ring);
+  CHECK(!ring.allocate(600, 1, allocation));
+
+  // The frame of the first allocation has completed
+  fences.endFrame(ring);
+  CHECK(ring.getUsedBytes() == 0);
+  CHECK(ring.allocate(600, 1, allocation));
+  CHECK(allocation.offset == 0);
+}
+
+TEST(StagingRing, WrapsWithoutStraddlingTheEnd) {
+  StagingRing ring(1000);
+  FakeFences fences{1};
+  StagingRing::Allocation allocation;
+
+  CHECK(ring.allocate(400, 1, allocation));
+  fences.endFrame(ring);
+  CHECK(ring.allocate(400, 1, allocation));
+  CHECK(allocation.offset == 400);
+  // Retires the first allocation, the second stays live
+  fences.endFrame(ring);
+
+  // Doesn't fit before the end, so it goes to the front
+  CHECK(ring.allocate(300, 1, allocation));
+  CHECK(allocation.offset == 0);
+  // The skipped tail of the ring counts as used until retired
+  CHECK(ring.getUsedBytes() == 400 + 200 + 300);
+  CHECK(!ring.allocate(150, 1, allocation));
+}
+
+TEST(StagingRing, DefersDestructionUntilRetired) {
+  StagingRing ring(1024);
+  FakeFences fences{2};
+
+  uint32_t destroyed = 0;
+  ring.deferDestroy([&destroyed]() { ++destroyed; });
+  fences.endFrame(ring);
+  fences.endFrame(ring);
+  CHECK(destroyed == 0);
+  CHECK(ring.getInFlightBatchCount() == 1);
+
+  fences.endFrame(ring);
+  CHECK(destroyed == 1);
+  CHECK(ring.getInFlightBatchCount() == 0);
+
+  // Never submitted, but retireAll runs it anyway
+  ring.deferDestroy([&destroyed]() { ++destroyed; });
+  ring.retireAll();
+  CHECK(destroyed == 2);
+}
+
+TEST(StagingRing, LiveAllocationsNeverOverlap) {
+  StagingRing ring(64 * 1024);
+  FakeFences fences{3};
+  std::mt19937 random(11);
+  std::uniform_int_distribution<size_t> sizes(1, 8 * 1024);
+  std::uniform_int_distribution<uint32_t> counts(0, 6);
+
+  // Allocations of each frame that hasn't completed yet
+  std::deque<std::vector<StagingRing::Allocation>> liveFrames;
+  uint32_t failedCount = 0;
+  for (uint32_t frame = 0; frame < 2000; ++frame) {
+    std::vector<StagingRing::Allocation>& frameAllocations =
+        liveFrames.emplace_back();
+    uint32_t count = counts(random);
+    for (uint32_t i = 0; i < count; ++i) {
+      StagingRing::Allocation allocation;
+      if (!ring.allocate(sizes(random), 256, allocation)) {
+        ++failedCount;
+        continue;
+      }
+
+      CHECK(allocation.offset % 256 == 0);
+      CHECK(allocation.offset + allocation.size <= ring.getCapacity());
+      for (const std::vector<StagingRing::Allocation>& live : liveFrames) {
+        for (const StagingRing::Allocation& other : live) {
+          CHECK(!overlaps(allocation, other));
+        }
+      }
+
+      frameAllocations.push_back(allocation);
+    }
+
+    fences.endFrame(ring);
+    if (liveFrames.size() > fences.latency) {
+      liveFrames.pop_front();
+    }
+  }
+
+  // The ring is sized so that it fills up now and then
+  CHECK(failedCount > 0);
+
+  ring.retireAll();
+  CHECK(ring.getUsedBytes() == 0);
+}
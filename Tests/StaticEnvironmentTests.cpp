@@ -0,0 +1,147 @@
+#include "StaticEnvironment.h"
+#include "TestFramework.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace PiesForAlthea;
+
+namespace {
+std::string writeTempFile(const std::string& name, const std::string& text) {
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / ("PiesForAltheaTest_" + name);
+  std::ofstream file(path, std::ios::binary);
+  file << text;
+  return path.string();
+}
+
+StaticEnvironment loadObjText(const std::string& text) {
+  std::string path = writeTempFile("environment.obj", text);
+  StaticEnvironment environment;
+  try {
+    environment.addObj(path);
+  } catch (...) {
+    std::filesystem::remove(path);
+    throw;
+  }
+
+  std::filesystem::remove(path);
+  return environment;
+}
+} // namespace
+
+TEST(StaticEnvironment, ObjReadsPositionsAndFaces) {
+  StaticEnvironment environment = loadObjText(
+      "# quad\r\n"
+      "v 0 0 0\r\n"
+      "v 1 0 0 # trailing comment\n"
+      "v 1 0 1\n"
+      "v 0 0 1\n"
+      "vn 0 1 0\n"
+      "f 1//1 2//1 3//1 -1//1\n");
+
+  CHECK(environment.getPositions().size() == 4);
+  CHECK(environment.getPositions()[1] == glm::vec3(1.0f, 0.0f, 0.0f));
+  CHECK(
+      environment.getIndices() ==
+      std::vector<uint32_t>({0, 1, 2, 0, 2, 3}));
+}
+
+TEST(StaticEnvironment, ObjRejectsShortLines) {
+  // Each short line is followed by numbers that would complete it if the
+  // parser read past the end of the line
+  CHECK_THROWS(loadObjText("v 1 2\n3 4 5\n"));
+  CHECK_THROWS(loadObjText("v 1 2\nv 3 4 5\n"));
+  CHECK_THROWS(loadObjText("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2\n3\n"));
+  CHECK_THROWS(loadObjText("v 0 0 0\nv 1 0 # 0\n"));
+}
+
+TEST(StaticEnvironment, HeightfieldFacesUp) {
+  StaticEnvironment environment;
+  environment.addHeightfield(
+      {0.0f, 1.0f, 2.0f, 0.0f, 1.0f, 2.0f},
+      3,
+      2,
+      glm::vec3(-1.0f, 0.0f, 0.0f),
+      2.0f);
+  environment.build();
+
+  CHECK(environment.getPositions().size() == 6);
+  CHECK(environment.getPositions()[5] == glm::vec3(3.0f, 2.0f, 2.0f));
+  CHECK(environment.getTriangleCount() == 4);
+
+  const std::vector<glm::vec3>& positions = environment.getPositions();
+  const std::vector<uint32_t>& indices = environment.getIndices();
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    glm::vec3 normal = glm::cross(
+        positions[indices[i + 1]] - positions[indices[i]],
+        positions[indices[i + 2]] - positions[indices[i]]);
+    CHECK(normal.y > 0.0f);
+  }
+
+  // Halfway up the first slope
+  uint32_t triangle = ~0u;
+  float distance = environment.raycast(
+      glm::vec3(0.0f, 10.0f, 1.0f),
+      glm::vec3(0.0f, -1.0f, 0.0f),
+      100.0f,
+      triangle);
+  CHECK(std::abs(distance - 9.5f) < 1e-5f);
+  CHECK(triangle < 2);
+
+  CHECK_THROWS(environment.addHeightfield(
+      {0.0f, 0.0f, 0.0f},
+      2,
+      2,
+      glm::vec3(0.0f),
+      1.0f));
+}
+
+TEST(StaticEnvironment, ObjCacheRoundTrip) {
+  std::string objPath = writeTempFile(
+      "cached.obj",
+      "v 0 0 0\n"
+      "v 1 0 0\n"
+      "v 1 0 1\n"
+      "v 0 0 1\n"
+      "f 1 2 3 4\n");
+  std::string cachePath = objPath + ".cache";
+  std::filesystem::remove(cachePath);
+
+  StaticEnvironment loaded =
+      StaticEnvironment::loadObjCached(objPath, cachePath);
+  CHECK(std::filesystem::exists(cachePath));
+
+  StaticEnvironment cached =
+      StaticEnvironment::loadObjCached(objPath, cachePath);
+  CHECK(cached.getPositions() == loaded.getPositions());
+  CHECK(cached.getIndices() == loaded.getIndices());
+  uint32_t triangle = ~0u;
+  CHECK(
+      cached.raycast(
+          glm::vec3(0.5f, 1.0f, 0.5f),
+          glm::vec3(0.0f, -1.0f, 0.0f),
+          10.0f,
+          triangle) < 10.0f);
+
+  // A cache built from another source is rejected
+  StaticEnvironment stale;
+  CHECK(!stale.readCache(cachePath, "another source"));
+  CHECK(stale.empty());
+
+  // As is one built with another transform
+  glm::mat4 transform(1.0f);
+  transform[3] = glm::vec4(0.0f, 5.0f, 0.0f, 1.0f);
+  StaticEnvironment moved =
+      StaticEnvironment::loadObjCached(objPath, cachePath, transform);
+  CHECK(moved.getPositions()[1] == glm::vec3(1.0f, 5.0f, 0.0f));
+
+  std::filesystem::remove(objPath);
+  std::filesystem::remove(cachePath);
+}
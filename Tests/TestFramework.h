@@ -0,0 +1,72 @@
+#pragma once
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace PiesForAlthea {
+// Just enough of a test harness for the parts that run without a device.
+// Tests are grouped into suites, each suite is registered with CTest on its
+// own so they can be run and reported separately.
+struct TestCase {
+  const char* suite;
+  const char* name;
+  void (*run)();
+};
+
+inline std::vector<TestCase>& getTestCases() {
+  static std::vector<TestCase> testCases;
+  return testCases;
+}
+
+struct TestRegistration {
+  TestRegistration(const char* suite, const char* name, void (*run)()) {
+    getTestCases().push_back({suite, name, run});
+  }
+};
+
+class TestFailure : public std::runtime_error {
+public:
+  TestFailure(const std::string& message) : std::runtime_error(message) {}
+};
+
+inline std::string
+formatFailure(const char* file, int line, const std::string& message) {
+  std::ostringstream stream;
+  stream << file << ":" << line << ": " << message;
+  return stream.str();
+}
+} // namespace PiesForAlthea
+
+#define TEST(suite, name)                                                      \
+  static void suite##_##name();                                                \
+  static PiesForAlthea::TestRegistration suite##_##name##_registration(        \
+      #suite,                                                                  \
+      #name,                                                                   \
+      &suite##_##name);                                                        \
+  static void suite##_##name()
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      throw PiesForAlthea::TestFailure(                                        \
+          PiesForAlthea::formatFailure(__FILE__, __LINE__, #condition));       \
+    }                                                                          \
+  } while (false)
+
+#define CHECK_THROWS(expression)                                               \
+  do {                                                                         \
+    bool threw = false;                                                        \
+    try {                                                                      \
+      expression;                                                              \
+    } catch (const std::exception&) {                                          \
+      threw = true;                                                            \
+    }                                                                          \
+    if (!threw) {                                                              \
+      throw PiesForAlthea::TestFailure(PiesForAlthea::formatFailure(           \
+          __FILE__,                                                            \
+          __LINE__,                                                            \
+          "expected to throw: " #expression));                                 \
+    }                                                                          \
+  } while (false)
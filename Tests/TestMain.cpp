@@ -0,0 +1,43 @@
+#include "TestFramework.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+using namespace PiesForAlthea;
+
+// Runs every test, or only the tests of the suite given as the first
+// argument
+int main(int argc, char** argv) {
+  const char* suite = argc > 1 ? argv[1] : nullptr;
+
+  uint32_t runCount = 0;
+  uint32_t failureCount = 0;
+  for (const TestCase& testCase : getTestCases()) {
+    if (suite && std::strcmp(suite, testCase.suite) != 0) {
+      continue;
+    }
+
+    ++runCount;
+    try {
+      testCase.run();
+      std::cout << "[ OK ] " << testCase.suite << "." << testCase.name
+                << std::endl;
+    } catch (const std::exception& e) {
+      ++failureCount;
+      std::cout << "[FAIL] " << testCase.suite << "." << testCase.name
+                << ": " << e.what() << std::endl;
+    }
+  }
+
+  if (runCount == 0) {
+    std::cout << "No tests matched" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << runCount - failureCount << "/" << runCount << " passed"
+            << std::endl;
+  return failureCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
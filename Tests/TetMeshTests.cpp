@@ -0,0 +1,199 @@
+#include "TestFramework.h"
+#include "TetMesh.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace PiesForAlthea;
+
+namespace {
+std::filesystem::path getTempPath(const std::string& name) {
+  return std::filesystem::temp_directory_path() /
+         ("PiesForAltheaTest_" + name);
+}
+
+void writeFile(const std::filesystem::path& path, const std::string& text) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << text;
+}
+
+// Two tets sharing the face 0 1 2, with nodes 3 and 4 on either side
+const char* BIPYRAMID_NODES = "# bipyramid\n"
+                              "5 3 0 0\n"
+                              "0 0 0 0\n"
+                              "1 1 0 0\n"
+                              "2 0 1 0\n"
+                              "3 0.2 0.2 1\n"
+                              "4 0.2 0.2 -1\n";
+const char* BIPYRAMID_TETS = "2 4 0\n"
+                             "0 0 1 2 3\n"
+                             "1 0 2 1 4\n";
+
+void removeTetGen(const std::string& base) {
+  for (const char* extension : {".node", ".ele", ".face", ".tetcache"}) {
+    std::filesystem::remove(base + extension);
+  }
+}
+
+std::string writeTetGen(
+    const std::string& name,
+    const std::string& nodes,
+    const std::string& tets) {
+  std::filesystem::path base = getTempPath(name);
+  removeTetGen(base.string());
+  writeFile(base.string() + ".node", nodes);
+  writeFile(base.string() + ".ele", tets);
+  return base.string();
+}
+
+// Every boundary triangle has to face away from the center of the convex
+// bipyramid
+bool isWoundOutwards(const TetMesh& mesh) {
+  const std::vector<glm::vec3>& positions = mesh.getPositions();
+  glm::vec3 center(0.0f);
+  for (const glm::vec3& position : positions) {
+    center += position / static_cast<float>(positions.size());
+  }
+
+  const std::vector<uint32_t>& triangles = mesh.getTriangles();
+  for (size_t i = 0; i < triangles.size(); i += 3) {
+    const glm::vec3& a = positions[triangles[i]];
+    const glm::vec3& b = positions[triangles[i + 1]];
+    const glm::vec3& c = positions[triangles[i + 2]];
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    if (glm::dot(normal, (a + b + c) / 3.0f - center) <= 0.0f) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void checkBipyramid(const TetMesh& mesh) {
+  CHECK(mesh.getNodeCount() == 5);
+  CHECK(mesh.getTetCount() == 2);
+  CHECK(mesh.getPositions()[3] == glm::vec3(0.2f, 0.2f, 1.0f));
+  CHECK(mesh.getLines().size() == 2 * 9);
+  // The shared face is interior
+  CHECK(mesh.getTriangles().size() == 3 * 6);
+  CHECK(isWoundOutwards(mesh));
+}
+} // namespace
+
+TEST(TetMesh, LoadsTetGen) {
+  std::string base =
+      writeTetGen("bipyramid", BIPYRAMID_NODES, BIPYRAMID_TETS);
+  checkBipyramid(TetMesh::loadTetGen(base + ".ele"));
+  removeTetGen(base);
+}
+
+TEST(TetMesh, LoadsOneBasedTetGen) {
+  std::string base = writeTetGen(
+      "bipyramidOneBased",
+      "5 3 0 0\n"
+      "1 0 0 0\n"
+      "2 1 0 0\n"
+      "3 0 1 0 # comment\n"
+      "\n"
+      "4 0.2 0.2 1\n"
+      "5 0.2 0.2 -1\n",
+      "2 4 0\n"
+      "1 1 2 3 4\n"
+      "2 1 3 2 5\n");
+  checkBipyramid(TetMesh::loadTetGen(base));
+  removeTetGen(base);
+}
+
+TEST(TetMesh, RejectsDuplicateRecords) {
+  // Node 1 is listed twice and node 3 is missing, the count still matches
+  std::string duplicateNode = writeTetGen(
+      "duplicateNode",
+      "5 3 0 0\n"
+      "0 0 0 0\n"
+      "1 1 0 0\n"
+      "1 0 1 0\n"
+      "2 0.2 0.2 1\n"
+      "4 0.2 0.2 -1\n",
+      BIPYRAMID_TETS);
+  CHECK_THROWS(TetMesh::loadTetGen(duplicateNode));
+
+  std::string duplicateTet = writeTetGen(
+      "duplicateTet",
+      BIPYRAMID_NODES,
+      "2 4 0\n"
+      "0 0 1 2 3\n"
+      "0 0 2 1 4\n");
+  CHECK_THROWS(TetMesh::loadTetGen(duplicateTet));
+
+  std::string missingTet = writeTetGen(
+      "missingTet",
+      BIPYRAMID_NODES,
+      "2 4 0\n"
+      "0 0 1 2 3\n");
+  CHECK_THROWS(TetMesh::loadTetGen(missingTet));
+
+  removeTetGen(duplicateNode);
+  removeTetGen(duplicateTet);
+  removeTetGen(missingTet);
+}
+
+TEST(TetMesh, LoadsMsh) {
+  std::filesystem::path path = getTempPath("bipyramid.msh");
+  writeFile(
+      path,
+      "$MeshFormat\n"
+      "2.2 0 8\n"
+      "$EndMeshFormat\n"
+      "$Nodes\n"
+      "5\n"
+      "10 0 0 0\n"
+      "11 1 0 0\n"
+      "12 0 1 0\n"
+      "13 0.2 0.2 1\n"
+      "14 0.2 0.2 -1\n"
+      "$EndNodes\n"
+      "$Elements\n"
+      "3\n"
+      "1 2 2 0 1 10 11 12\n"
+      "2 4 2 0 1 10 11 12 13\n"
+      "3 4 2 0 1 10 12 11 14\n"
+      "$EndElements\n");
+  checkBipyramid(TetMesh::loadMsh(path.string()));
+
+  // Tag 11 is given to two nodes
+  writeFile(
+      path,
+      "$MeshFormat\n"
+      "2.2 0 8\n"
+      "$EndMeshFormat\n"
+      "$Nodes\n"
+      "2\n"
+      "11 0 0 0\n"
+      "11 1 0 0\n"
+      "$EndNodes\n");
+  CHECK_THROWS(TetMesh::loadMsh(path.string()));
+  std::filesystem::remove(path);
+}
+
+TEST(TetMesh, CacheRoundTrip) {
+  std::string base =
+      writeTetGen("bipyramidCached", BIPYRAMID_NODES, BIPYRAMID_TETS);
+  TetMesh loaded = TetMesh::loadCached(base + ".node");
+  CHECK(std::filesystem::exists(base + ".tetcache"));
+
+  TetMesh cached;
+  CHECK(!cached.readCache(base + ".tetcache", "another source"));
+  CHECK(cached.getNodeCount() == 0);
+
+  cached = TetMesh::loadCached(base + ".node");
+  checkBipyramid(cached);
+  CHECK(cached.getTets() == loaded.getTets());
+  CHECK(cached.getLines() == loaded.getLines());
+  CHECK(cached.getTriangles() == loaded.getTriangles());
+  removeTetGen(base);
+}